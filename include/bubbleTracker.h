@@ -6,6 +6,7 @@
 #include <bubble.h>
 
 struct VelocityGrid;
+class VelocityCache;
 class State;
 
 template<typename T>
@@ -28,7 +29,8 @@ public:
     glm::vec3 g,
     float dt
     );*/
-  void advect(State *stateFrom, State *stateTo, OrdinalGrid<double> *pressures, glm::vec3 g, float dt);
+  void advect(State *stateFrom, State *stateTo, OrdinalGrid<double> *pressures, glm::vec3 g, float dt,
+              VelocityCache const* velocityCache = nullptr);
   
 private:
 
@@ -2,7 +2,7 @@
 
 namespace factory{
   namespace levelSet{
-    LevelSet* ball(unsigned int w, unsigned int h, unsigned int d){
+    inline LevelSet* ball(unsigned int w, unsigned int h, unsigned int d){
       return new LevelSet(w, h, d,
         [=](const unsigned int &i, const unsigned int &j, const unsigned int &k) {
           // distance function to sphere with radius w/3, center in (w/2, h/2, d/2)
@@ -37,7 +37,42 @@ namespace factory{
     }
 
 
-    LevelSet* halfContainerBox(unsigned int w, unsigned int h, unsigned int d){
+    inline LevelSet* droplet(unsigned int w, unsigned int h, unsigned int d){
+      return new LevelSet(w, h, d,
+        [=](const unsigned int &i, const unsigned int &j, const unsigned int &k) {
+          // distance function to sphere with radius w/10, high up in a corner of the container
+          const float x = (float)i - (float)w/4.0;
+          const float y = (float)j - (float)h*0.75;
+          const float z = (float)k - (float)d/4.0;
+
+          return sqrt( x*x + y*y + z*z) - (float)w/10.0;
+        }, [=](unsigned int i, unsigned int j, unsigned int k){
+          CellType bt = CellType::EMPTY;
+
+          if(i == 0){
+            bt = CellType::SOLID;
+          }
+          else if(j == 0){
+            bt = CellType::SOLID;
+          }
+          else if(k == 0){
+            bt = CellType::SOLID;
+          }
+          else if(i == w - 1){
+            bt = CellType::SOLID;
+          }
+          else if(j == h - 1){
+            bt = CellType::SOLID;
+          }
+          else if(k == d - 1){
+            bt = CellType::SOLID;
+          }
+          return bt;
+        });
+    }
+
+
+    inline LevelSet* halfContainerBox(unsigned int w, unsigned int h, unsigned int d){
       return new LevelSet(w, h, d,
         [=](const unsigned int &i, const unsigned int &j, const unsigned int &k) {
           // fill half the container with fluid
@@ -68,7 +103,38 @@ namespace factory{
         });
     }
 
-    LevelSet* fourthContainerBox(unsigned int w, unsigned int h, unsigned int d){
+    inline LevelSet* pool(unsigned int w, unsigned int h, unsigned int d){
+      return new LevelSet(w, h, d,
+        [=](const unsigned int &i, const unsigned int &j, const unsigned int &k) {
+          // still water filling the bottom half of the container
+          return (j > 0 && j < h/2 && i > 0 && i < w - 1 && k > 0 && k < d - 1) ? -0.5 : 0.5;
+
+        }, [=](unsigned int i, unsigned int j, unsigned int k){
+          CellType bt = CellType::EMPTY;
+
+          if(i == 0){
+            bt = CellType::SOLID;
+          }
+          else if(j == 0){
+            bt = CellType::SOLID;
+          }
+          else if(k == 0){
+            bt = CellType::SOLID;
+          }
+          else if(i == w - 1){
+            bt = CellType::SOLID;
+          }
+          else if(j == h - 1){
+            bt = CellType::SOLID;
+          }
+          else if(k == d - 1){
+            bt = CellType::SOLID;
+          }
+          return bt;
+        });
+    }
+
+    inline LevelSet* fourthContainerBox(unsigned int w, unsigned int h, unsigned int d){
       return new LevelSet(w, h, d,
         [=](const unsigned int &i, const unsigned int &j, const unsigned int &k) {
           // fill half the container with fluid
@@ -99,7 +165,7 @@ namespace factory{
         });
     }
 
-    LevelSet* fourthContainerBoxInFluid(unsigned int w, unsigned int h, unsigned int d){
+    inline LevelSet* fourthContainerBoxInFluid(unsigned int w, unsigned int h, unsigned int d){
       return new LevelSet(w, h, d,
               [=](const unsigned int &i, const unsigned int &j, const unsigned int &k) {
                   return (j > h/6 && j < 5*h/6 && k > d/4+3 && k < 3*d/4+3 && i > w/8 && i < 3*w/8) || (j < h/3)  ? -0.5 : 0.5;
@@ -128,7 +194,7 @@ namespace factory{
                   return bt;
               });
     }
-    LevelSet* twoPillars(unsigned int w, unsigned int h, unsigned int d){
+    inline LevelSet* twoPillars(unsigned int w, unsigned int h, unsigned int d){
       return new LevelSet(w, h, d,
         [=](const unsigned int &i, const unsigned int &j, const unsigned int &k) {
           // fill half the container with fluid
@@ -164,7 +230,7 @@ namespace factory{
         });
     }
 
-    LevelSet* stairs(unsigned int w, unsigned int h, unsigned int d){
+    inline LevelSet* stairs(unsigned int w, unsigned int h, unsigned int d){
       return new LevelSet(w, h, d,
         [=](const unsigned int &i, const unsigned int &j, const unsigned int &k) {
           // fill half the container with fluid
@@ -0,0 +1,25 @@
+#pragma once
+#include <micPreconditioner.h>
+#include <multigridPreconditioner.h>
+#include <string>
+
+namespace factory{
+  namespace preconditioner{
+    /**
+     * Pressure preconditioner by name: "mic", "mic-parallel" or "multigrid".
+     * nullptr for any other name.
+     */
+    inline Preconditioner* byName(const std::string &name){
+      if (name == "mic") {
+        return new MICPreconditioner();
+      }
+      if (name == "mic-parallel") {
+        return new MICPreconditioner(true);
+      }
+      if (name == "multigrid") {
+        return new MultigridPreconditioner();
+      }
+      return nullptr;
+    }
+  }
+}
@@ -0,0 +1,61 @@
+#pragma once
+#include <grid.h>
+#include <state.h>
+#include <vector>
+
+template<typename T>
+class OrdinalGrid;
+
+/**
+ * Numbering of the FLUID cells of a cell type grid, the unknowns of the pressure system.
+ * Fluid cells are numbered in flat k*w*h + j*w + i order, so the numbering keeps
+ * the lexicographic order that MIC(0) relies on.
+ */
+class FluidCellIndex {
+public:
+  FluidCellIndex();
+
+  void build(State const* const state);
+  void build(Grid<CellType> const* const cellTypeGrid);
+
+  /**
+   * Number of fluid cells.
+   */
+  unsigned int size() const;
+
+  /**
+   * Index of the fluid cell at i, j, k, or NOT_FLUID for other cells and
+   * positions outside the grid.
+   */
+  int get(int i, int j, int k) const;
+
+  GridCoordinate getCell(unsigned int index) const;
+
+  /**
+   * Gather a grid into a vector of fluid cell values.
+   */
+  template<typename T>
+  void gather(OrdinalGrid<T> const* const grid, std::vector<double> &values) const;
+
+  /**
+   * Write values to the fluid cells of a grid, and zero to all other cells.
+   */
+  void scatter(const std::vector<double> &values, OrdinalGrid<double> *grid) const;
+
+  static constexpr int NOT_FLUID = -1;
+
+private:
+  unsigned int w, h, d;
+  std::vector<int> indices;
+  std::vector<GridCoordinate> cells;
+};
+
+template<typename T>
+void FluidCellIndex::gather(OrdinalGrid<T> const* const grid, std::vector<double> &values) const{
+  const int count = cells.size();
+  values.resize(count);
+  #pragma omp parallel for
+  for (int n = 0; n < count; n++) {
+    values[n] = grid->get(cells[n]);
+  }
+}
@@ -1,10 +1,45 @@
 #pragma once
 #include <functional>
+#include <algorithm>
 #include <glm/glm.hpp>
 #include <iostream>
+#include <vector>
 
 typedef glm::i32vec3 GridCoordinate;
 
+/**
+ * Memory layout of the cells in a grid.
+ * FLAT stores cells in k*w*h + j*w + i order.
+ * BRICKED stores cells in 8x8x8 tiles, so that 3D stencils touch contiguous memory.
+ * SPARSE uses the same tiles, but only allocates tiles whose cells differ.
+ * Tiles where every cell has the same value are stored as that single value.
+ */
+enum class GridLayout {
+  FLAT, BRICKED, SPARSE
+};
+
+/**
+ * Layout used by grids constructed without an explicit layout.
+ * Defaults to BRICKED when compiled with PINK_FLUID_BRICKED_GRIDS.
+ */
+inline GridLayout& defaultGridLayout() {
+#ifdef PINK_FLUID_BRICKED_GRIDS
+  static GridLayout layout = GridLayout::BRICKED;
+#else
+  static GridLayout layout = GridLayout::FLAT;
+#endif
+  return layout;
+}
+
+/**
+ * How the ghost cells around a haloed grid are filled by refreshHalo.
+ * ZERO fills them with T(0), CLAMP repeats the nearest boundary cell and
+ * REFLECT mirrors the cells next to the boundary, as behind a solid wall.
+ */
+enum class HaloPolicy {
+  ZERO, CLAMP, REFLECT
+};
+
 template <class T>
 class Grid {
  public:
@@ -13,14 +48,27 @@ class Grid {
    * Constructor.
    * @param w width
    * @param h height
+   * @param layout memory layout of the cells
    */
-  Grid(unsigned int w, unsigned int h, unsigned int d) {
+  Grid(unsigned int w, unsigned int h, unsigned int d, GridLayout layout = defaultGridLayout()) {
     this->w = w;
     this->h = h;
     this->d = d;
-    // int size = this->size();
-    quantities = new T[w*h*d];
-    for(auto i = 0u; i < size(); i++){
+    this->layout = layout;
+    initializeLayout();
+    initializeHalo(0, HaloPolicy::ZERO);
+    if (layout == GridLayout::SPARSE) {
+      quantities = nullptr;
+      bricks = new T*[brickCount];
+      brickValues = new T[brickCount];
+      for(auto b = 0u; b < brickCount; b++){
+        bricks[b] = nullptr;
+        brickValues[b] = T(0);
+      }
+      return;
+    }
+    quantities = new T[capacity];
+    for(auto i = 0u; i < capacity; i++){
       quantities[i] = T(0);
     }
   };
@@ -29,15 +77,40 @@ class Grid {
     this->w = origin.w;
     this->h = origin.h;
     this->d = origin.d;
+    this->layout = origin.layout;
+    initializeLayout();
+    initializeHalo(origin.halo, origin.haloPolicy);
 
-    quantities = new T[w*h*d];
-    for (auto i = 0u; i < size(); i++) {
+    if (layout == GridLayout::SPARSE) {
+      quantities = nullptr;
+      bricks = new T*[brickCount];
+      brickValues = new T[brickCount];
+      for(auto b = 0u; b < brickCount; b++){
+        brickValues[b] = origin.brickValues[b];
+        bricks[b] = nullptr;
+        if (origin.bricks[b]) {
+          bricks[b] = new T[BRICK_VOLUME];
+          std::copy(origin.bricks[b], origin.bricks[b] + BRICK_VOLUME, bricks[b]);
+        }
+      }
+      return;
+    }
+
+    quantities = new T[capacity];
+    for (auto i = 0u; i < capacity; i++) {
       quantities[i] = origin.quantities[i];
     }
   };
 
   ~Grid(){
     delete[] quantities;
+    if (layout == GridLayout::SPARSE) {
+      for(auto b = 0u; b < brickCount; b++){
+        delete[] bricks[b];
+      }
+      delete[] bricks;
+      delete[] brickValues;
+    }
   }
 
   /**
@@ -49,23 +122,380 @@ class Grid {
   };
 
 
+  /**
+   * Number of values held in memory, including the padding of partially filled bricks.
+   * For sparse grids this counts the allocated bricks and one value per uniform brick.
+   */
+  unsigned int storageSize() const{
+    if (layout == GridLayout::SPARSE) {
+      return allocatedBricks()*BRICK_VOLUME + brickCount;
+    }
+    return capacity;
+  };
+
+  /**
+   * Number of bricks with allocated storage. Only sparse grids leave bricks unallocated.
+   */
+  unsigned int allocatedBricks() const{
+    if (layout != GridLayout::SPARSE) {
+      return brickCount;
+    }
+    unsigned int allocated = 0;
+    for(auto b = 0u; b < brickCount; b++){
+      allocated += bricks[b] ? 1 : 0;
+    }
+    return allocated;
+  }
+
+  /**
+   * Whether the brick containing a cell holds a single value for all of its cells.
+   * Always false for dense layouts.
+   */
+  bool isBrickUniform(unsigned int i, unsigned int j, unsigned int k) const{
+    if (layout != GridLayout::SPARSE) {
+      return false;
+    }
+    return bricks[indexTranslation(i, j, k) / BRICK_VOLUME] == nullptr;
+  }
+
+  /**
+   * Release the storage of sparse bricks where every cell has the same value.
+   * Does nothing for dense layouts.
+   */
+  void prune(){
+    if (layout != GridLayout::SPARSE) {
+      return;
+    }
+    const unsigned int bricksW = (w + BRICK_SIZE - 1) / BRICK_SIZE;
+    const unsigned int bricksH = (h + BRICK_SIZE - 1) / BRICK_SIZE;
+    forEachSparseBrick([&](unsigned int bi, unsigned int bj, unsigned int bk) {
+        const unsigned int b = (bk*bricksH + bj)*bricksW + bi;
+        if (!bricks[b]) {
+          return;
+        }
+        const T first = bricks[b][0];
+        bool uniform = true;
+        const unsigned int kEnd = std::min((bk + 1)*BRICK_SIZE, d) - bk*BRICK_SIZE;
+        const unsigned int jEnd = std::min((bj + 1)*BRICK_SIZE, h) - bj*BRICK_SIZE;
+        const unsigned int iEnd = std::min((bi + 1)*BRICK_SIZE, w) - bi*BRICK_SIZE;
+        for(auto k = 0u; k < kEnd && uniform; k++){
+          for(auto j = 0u; j < jEnd && uniform; j++){
+            for(auto i = 0u; i < iEnd && uniform; i++){
+              uniform = bricks[b][(k*BRICK_SIZE + j)*BRICK_SIZE + i] == first;
+            }
+          }
+        }
+        if (uniform) {
+          delete[] bricks[b];
+          bricks[b] = nullptr;
+          brickValues[b] = first;
+        }
+      });
+  }
+
+  GridLayout getLayout() const{
+    return layout;
+  }
+
+  /**
+   * Pad a FLAT grid with width ghost cells on every side, filled according to policy.
+   * Ghost cells are not updated by set, call refreshHalo once the interior is written.
+   * Only FLAT grids can have a halo.
+   */
+  void setHalo(unsigned int width, HaloPolicy policy){
+    assert(layout == GridLayout::FLAT);
+    if (layout != GridLayout::FLAT) {
+      return;
+    }
+    if (width == halo) {
+      haloPolicy = policy;
+      refreshHalo();
+      return;
+    }
+    Grid<T> interior(*this);
+    delete[] quantities;
+    initializeHalo(width, policy);
+    quantities = new T[capacity];
+    forEachCell([&](unsigned int i, unsigned int j, unsigned int k, unsigned int index) {
+        quantities[index] = interior.get(i, j, k);
+      });
+    refreshHalo();
+  }
+
+  unsigned int getHalo() const{
+    return halo;
+  }
+
+  HaloPolicy getHaloPolicy() const{
+    return haloPolicy;
+  }
+
+  /**
+   * Fill the ghost cells from the interior, according to the halo policy.
+   */
+  void refreshHalo(){
+    if (halo == 0) {
+      return;
+    }
+    const int g = halo;
+    const int iw = w, ih = h, id = d;
+    #pragma omp parallel for
+    for(int k = -g; k < id + g; k++){
+      for(int j = -g; j < ih + g; j++){
+        const bool interiorRow = j >= 0 && j < ih && k >= 0 && k < id;
+        for(int i = -g; i < iw + g; i++){
+          if (interiorRow && i == 0) {
+            i = iw - 1;
+            continue;
+          }
+          quantities[haloIndex(i, j, k)] = ghostValue(i, j, k);
+        }
+      }
+    }
+  }
+
+  /**
+   * Storage index of a cell in a haloed FLAT grid, valid from -halo to w + halo - 1 along x,
+   * and likewise along y and z.
+   */
+  inline int haloIndex(int i, int j, int k) const{
+    return haloOffset + k*strideZ + j*strideY + i;
+  }
+
+  /**
+   * Get a cell or ghost cell of a haloed grid, without bounds checks.
+   */
+  inline T haloGet(int i, int j, int k) const{
+    return quantities[haloIndex(i, j, k)];
+  }
+
   /**
    * Function in order to set each cell in a grid using a lambda.
-   * @param func Function to apply for each cell
+   * The kernel is a template parameter, so it is inlined into the loop.
+   * Bricked grids are visited brick by brick, so that writes stay contiguous.
+   * Sparse bricks that end up with a single value are stored without allocation.
+   * @param func Function to apply for each cell, func(i, j, k)
    */
-  void setForEach(const std::function< T (unsigned int i, unsigned int j, unsigned int k)> func){
-    #pragma omp parallel for collapse(3)
-    for(auto k = 0u; k < d; k++){
-      for(auto j = 0u; j < h; j++){
-        for(auto i = 0u; i < w; i++){
-          set(i, j, k, func(i, j, k));
+  template <class Kernel>
+  void setForEach(Kernel func){
+    if (layout == GridLayout::SPARSE) {
+      forEachSparseBrick([&](unsigned int bi, unsigned int bj, unsigned int bk) {
+          setSparseBrick(bi, bj, bk, func);
+        });
+      return;
+    }
+    forEachCell([&](unsigned int i, unsigned int j, unsigned int k, unsigned int index) {
+        quantities[index] = func(i, j, k);
+      });
+  }
+
+  /**
+   * Like setForEach, but the kernel also gets the storage index of the cell.
+   * Grids of the same size, layout and halo share storage indices, so the kernel
+   * can read them with get(index) instead of translating i, j, k.
+   * @param func Function to apply for each cell, func(i, j, k, index)
+   */
+  template <class Kernel>
+  void setForEachIndexed(Kernel func){
+    if (layout == GridLayout::SPARSE) {
+      setForEach([&](unsigned int i, unsigned int j, unsigned int k) {
+          return func(i, j, k, indexTranslation(i, j, k));
+        });
+      return;
+    }
+    forEachCell([&](unsigned int i, unsigned int j, unsigned int k, unsigned int index) {
+        quantities[index] = func(i, j, k, index);
+      });
+  }
+
+  /**
+   * Let the kernel fill one x row at a time, rows are processed in parallel.
+   * For FLAT grids row points straight into the grid, for other layouts it is a
+   * copy of the row that is written back afterwards. Bricked rows are handed out
+   * a brick row at a time, so no two threads write to the same brick.
+   * @param func Function to apply for each row, func(j, k, T *row), with w values in row
+   */
+  template <class Kernel>
+  void setForEachRow(Kernel func){
+    setForEachRowReduce(0, [&](unsigned int j, unsigned int k, T *row) {
+        func(j, k, row);
+        return 0;
+      }, [](int, int) {
+        return 0;
+      });
+  }
+
+  /**
+   * setForEachRow where each row also returns a value, which are reduced as in reduce.
+   * @param identity neutral value of combine
+   * @param func Function to apply for each row, func(j, k, T *row), returning the value of the row
+   * @param combine Merge two partial results, combine(a, b)
+   */
+  template <class R, class Kernel, class Combine>
+  R setForEachRowReduce(R identity, Kernel func, Combine combine){
+    return setForEachRowReduceInBox(GridCoordinate(0), GridCoordinate(w - 1, h - 1, d - 1), identity, func, combine);
+  }
+
+  /**
+   * setForEachRow limited to the cells from lower to upper, inclusive and clamped
+   * to the grid. row is still indexed by i and the kernel must only write row[lower.x]
+   * to row[upper.x]: FLAT rows are the grid storage, other layouts discard the rest.
+   */
+  template <class Kernel>
+  void setForEachRowInBox(GridCoordinate lower, GridCoordinate upper, Kernel func){
+    setForEachRowReduceInBox(lower, upper, 0, [&](unsigned int j, unsigned int k, T *row) {
+        func(j, k, row);
+        return 0;
+      }, [](int, int) {
+        return 0;
+      });
+  }
+
+  /**
+   * setForEachRowReduce limited to a box, as setForEachRowInBox.
+   */
+  template <class R, class Kernel, class Combine>
+  R setForEachRowReduceInBox(GridCoordinate lower, GridCoordinate upper, R identity, Kernel func, Combine combine){
+    lower = glm::max(lower, GridCoordinate(0));
+    upper = glm::min(upper, GridCoordinate(w - 1, h - 1, d - 1));
+    R result = identity;
+    if (lower.x > upper.x || lower.y > upper.y || lower.z > upper.z) {
+      return result;
+    }
+    if (layout == GridLayout::FLAT) {
+      #pragma omp parallel
+      {
+        R partial = identity;
+        #pragma omp for collapse(2) nowait
+        for(int k = lower.z; k <= upper.z; k++){
+          for(int j = lower.y; j <= upper.y; j++){
+            partial = combine(partial, func(j, k, quantities + indexTranslation(0, j, k)));
+          }
         }
+        #pragma omp critical
+        result = combine(result, partial);
       }
+      return result;
     }
+
+    const int firstBrickJ = lower.y / BRICK_SIZE;
+    const int firstBrickK = lower.z / BRICK_SIZE;
+    const int lastBrickJ = upper.y / BRICK_SIZE;
+    const int lastBrickK = upper.z / BRICK_SIZE;
+    #pragma omp parallel
+    {
+      R partial = identity;
+      std::vector<T> buffer(w);
+      #pragma omp for collapse(2) nowait
+      for(int bk = firstBrickK; bk <= lastBrickK; bk++){
+        for(int bj = firstBrickJ; bj <= lastBrickJ; bj++){
+          const int kEnd = std::min((bk + 1)*(int)BRICK_SIZE - 1, upper.z);
+          const int jEnd = std::min((bj + 1)*(int)BRICK_SIZE - 1, upper.y);
+          for(int k = std::max(bk*(int)BRICK_SIZE, lower.z); k <= kEnd; k++){
+            for(int j = std::max(bj*(int)BRICK_SIZE, lower.y); j <= jEnd; j++){
+              getRow(j, k, buffer.data());
+              partial = combine(partial, func(j, k, buffer.data()));
+              for(int i = lower.x; i <= upper.x; i++){
+                set(i, j, k, buffer[i]);
+              }
+            }
+          }
+        }
+      }
+      #pragma omp critical
+      result = combine(result, partial);
+    }
+    return result;
   }
 
+  /**
+   * Copy the w values of the x row j, k to row.
+   */
+  void getRow(unsigned int j, unsigned int k, T *row) const{
+    if (layout == GridLayout::FLAT) {
+      const T *begin = quantities + indexTranslation(0, j, k);
+      std::copy(begin, begin + w, row);
+      return;
+    }
+    for(auto i = 0u; i < w; i++){
+      row[i] = get(i, j, k);
+    }
+  }
 
+  /**
+   * The w values of the x row j, k. FLAT grids return their storage, other layouts
+   * copy the row to buffer, which holds w values, and return it.
+   */
+  const T *readRow(unsigned int j, unsigned int k, T *buffer) const{
+    if (layout == GridLayout::FLAT) {
+      return quantities + indexTranslation(0, j, k);
+    }
+    getRow(j, k, buffer);
+    return buffer;
+  }
+
+  /**
+   * Let the kernel fill the cells lower to upper of the x row j, k, on the calling thread.
+   * Like setForEachRowInBox, row is indexed by i and only lower to upper may be written.
+   * Other layouts than FLAT fill buffer, which holds w values. Threads may fill rows of
+   * different bricks at the same time.
+   */
+  template <class Kernel>
+  void setRowInBox(unsigned int j, unsigned int k, int lower, int upper, T *buffer, Kernel func){
+    if (layout == GridLayout::FLAT) {
+      func(quantities + indexTranslation(0, j, k));
+      return;
+    }
+    getRow(j, k, buffer);
+    func(buffer);
+    for(int i = lower; i <= upper; i++){
+      set(i, j, k, buffer[i]);
+    }
+  }
+
+  /**
+   * Parallel reduction over all cells.
+   * @param identity neutral value of combine
+   * @param func Value of a single cell, func(i, j, k)
+   * @param combine Merge two partial results, combine(a, b)
+   */
+  template <class R, class Kernel, class Combine>
+  R reduce(R identity, Kernel func, Combine combine) const{
+    return reduceInBox(GridCoordinate(0), GridCoordinate(w - 1, h - 1, d - 1), identity, func, combine);
+  }
+
+  /**
+   * reduce over the cells from lower to upper, inclusive and clamped to the grid.
+   */
+  template <class R, class Kernel, class Combine>
+  R reduceInBox(GridCoordinate lower, GridCoordinate upper, R identity, Kernel func, Combine combine) const{
+    lower = glm::max(lower, GridCoordinate(0));
+    upper = glm::min(upper, GridCoordinate(w - 1, h - 1, d - 1));
+    R result = identity;
+    #pragma omp parallel
+    {
+      R partial = identity;
+      #pragma omp for collapse(2) nowait
+      for(int k = lower.z; k <= upper.z; k++){
+        for(int j = lower.y; j <= upper.y; j++){
+          for(int i = lower.x; i <= upper.x; i++){
+            partial = combine(partial, func(i, j, k));
+          }
+        }
+      }
+      #pragma omp critical
+      result = combine(result, partial);
+    }
+    return result;
+  }
+
+  /**
+   * Get a value by its storage index, see indexTranslation.
+   */
   T get(unsigned int i) const{
+    if (layout == GridLayout::SPARSE) {
+      return sparseGet(i);
+    }
     return quantities[i];
   }
 
@@ -83,7 +513,10 @@ class Grid {
     assert(i < w);
     assert(j < h);
     assert(k < d);
-    return quantities[k*w*h + j*w + i];
+    if (layout == GridLayout::SPARSE) {
+      return sparseGet(indexTranslation(i, j, k));
+    }
+    return quantities[indexTranslation(i, j, k)];
   };
 
   inline T get(GridCoordinate c) const{
@@ -98,8 +531,14 @@ class Grid {
     return this->clampGet(c.x, c.y, c.z);
   };
 
+  /**
+   * Storage index of a cell. Only equal to k*w*h + j*w + i for FLAT grids without a halo.
+   */
   inline unsigned int indexTranslation(unsigned int i, unsigned int j, unsigned int k) const{
-    return k*w*h + j*w + i;
+    if (layout == GridLayout::FLAT) {
+      return haloOffset + k*strideZ + j*strideY + i;
+    }
+    return xOffsets[i] + yOffsets[j] + zOffsets[k];
   }
 
   T clampGet(int i, int j, int k) const {
@@ -136,9 +575,15 @@ class Grid {
 
   /**
    * Set value of the stored quantity.
+   * Setting cells of the same unallocated sparse brick from several threads is not safe,
+   * use setForEach for parallel writes to sparse grids.
    */
   void set(unsigned int i, unsigned int j, unsigned int k, T value) {
-    quantities[k*w*h + j*w + i] = value;
+    if (layout == GridLayout::SPARSE) {
+      sparseSet(indexTranslation(i, j, k), value);
+      return;
+    }
+    quantities[indexTranslation(i, j, k)] = value;
   };
 
   inline void set(GridCoordinate c, T value) {
@@ -156,12 +601,28 @@ class Grid {
     return d;
   }
 
+  /**
+   * Streams are always written in FLAT order, regardless of layout.
+   */
   std::ostream& write(std::ostream& stream){
     stream.write(reinterpret_cast<char*>(&w), sizeof(w));
     stream.write(reinterpret_cast<char*>(&h), sizeof(h));
     stream.write(reinterpret_cast<char*>(&d), sizeof(d));
     long dataLength = w * h * d;
-    stream.write(reinterpret_cast<char*>(quantities), sizeof(T)*dataLength);
+    if (layout == GridLayout::FLAT && halo == 0) {
+      stream.write(reinterpret_cast<char*>(quantities), sizeof(T)*dataLength);
+      return stream;
+    }
+    T *flat = new T[dataLength];
+    for(auto k = 0u; k < d; k++){
+      for(auto j = 0u; j < h; j++){
+        for(auto i = 0u; i < w; i++){
+          flat[k*w*h + j*w + i] = get(i, j, k);
+        }
+      }
+    }
+    stream.write(reinterpret_cast<char*>(flat), sizeof(T)*dataLength);
+    delete[] flat;
     return stream;
   }
 
@@ -170,12 +631,225 @@ class Grid {
     stream.read(reinterpret_cast<char*>(&h), sizeof(h));
     stream.read(reinterpret_cast<char*>(&d), sizeof(d));
     long dataLength = w * h * d;
-    stream.read(reinterpret_cast<char*>(quantities), sizeof(T)*dataLength);
+    if (layout == GridLayout::FLAT && halo == 0) {
+      stream.read(reinterpret_cast<char*>(quantities), sizeof(T)*dataLength);
+      return stream;
+    }
+    T *flat = new T[dataLength];
+    stream.read(reinterpret_cast<char*>(flat), sizeof(T)*dataLength);
+    for(auto k = 0u; k < d; k++){
+      for(auto j = 0u; j < h; j++){
+        for(auto i = 0u; i < w; i++){
+          set(i, j, k, flat[k*w*h + j*w + i]);
+        }
+      }
+    }
+    delete[] flat;
+    prune();
+    refreshHalo();
     return stream;
   }
-  
+
+  static constexpr unsigned int BRICK_SIZE = 8;
+  static constexpr unsigned int BRICK_VOLUME = BRICK_SIZE*BRICK_SIZE*BRICK_SIZE;
+
  protected:
   unsigned int w, h, d;
+  GridLayout layout;
   T *quantities;
-  
+
+  // FLAT indexing, strides and offset of the first interior cell include the halo
+  unsigned int halo;
+  HaloPolicy haloPolicy;
+  int strideY, strideZ, haloOffset;
+
+ private:
+  inline T sparseGet(unsigned int index) const{
+    const T *brick = bricks[index / BRICK_VOLUME];
+    return brick ? brick[index % BRICK_VOLUME] : brickValues[index / BRICK_VOLUME];
+  }
+
+  void sparseSet(unsigned int index, T value) {
+    const unsigned int b = index / BRICK_VOLUME;
+    if (!bricks[b]) {
+      if (value == brickValues[b]) {
+        return;
+      }
+      bricks[b] = new T[BRICK_VOLUME];
+      std::fill(bricks[b], bricks[b] + BRICK_VOLUME, brickValues[b]);
+    }
+    bricks[b][index % BRICK_VOLUME] = value;
+  }
+
+  /**
+   * Visit every cell in parallel with body(i, j, k, index), where index is the storage index.
+   * FLAT grids are visited row by row, other layouts brick by brick.
+   */
+  template <class Body>
+  void forEachCell(Body body) const{
+    if (layout == GridLayout::FLAT) {
+      #pragma omp parallel for collapse(2)
+      for(auto k = 0u; k < d; k++){
+        for(auto j = 0u; j < h; j++){
+          const unsigned int row = indexTranslation(0, j, k);
+          for(auto i = 0u; i < w; i++){
+            body(i, j, k, row + i);
+          }
+        }
+      }
+      return;
+    }
+
+    const unsigned int bricksW = (w + BRICK_SIZE - 1) / BRICK_SIZE;
+    const unsigned int bricksH = (h + BRICK_SIZE - 1) / BRICK_SIZE;
+    const unsigned int bricksD = (d + BRICK_SIZE - 1) / BRICK_SIZE;
+    #pragma omp parallel for collapse(3)
+    for(auto bk = 0u; bk < bricksD; bk++){
+      for(auto bj = 0u; bj < bricksH; bj++){
+        for(auto bi = 0u; bi < bricksW; bi++){
+          const unsigned int kEnd = std::min((bk + 1)*BRICK_SIZE, d);
+          const unsigned int jEnd = std::min((bj + 1)*BRICK_SIZE, h);
+          const unsigned int iEnd = std::min((bi + 1)*BRICK_SIZE, w);
+          for(auto k = bk*BRICK_SIZE; k < kEnd; k++){
+            for(auto j = bj*BRICK_SIZE; j < jEnd; j++){
+              for(auto i = bi*BRICK_SIZE; i < iEnd; i++){
+                body(i, j, k, indexTranslation(i, j, k));
+              }
+            }
+          }
+        }
+      }
+    }
+  }
+
+  /**
+   * Visit every brick in parallel with body(bi, bj, bk).
+   */
+  template <class Body>
+  void forEachSparseBrick(Body body){
+    const unsigned int bricksW = (w + BRICK_SIZE - 1) / BRICK_SIZE;
+    const unsigned int bricksH = (h + BRICK_SIZE - 1) / BRICK_SIZE;
+    const unsigned int bricksD = (d + BRICK_SIZE - 1) / BRICK_SIZE;
+    #pragma omp parallel for collapse(3)
+    for(auto bk = 0u; bk < bricksD; bk++){
+      for(auto bj = 0u; bj < bricksH; bj++){
+        for(auto bi = 0u; bi < bricksW; bi++){
+          body(bi, bj, bk);
+        }
+      }
+    }
+  }
+
+  /**
+   * Evaluate func over one sparse brick, keeping the brick unallocated if all values are equal.
+   */
+  template <class Kernel>
+  void setSparseBrick(unsigned int bi, unsigned int bj, unsigned int bk, Kernel &func) {
+    const unsigned int bricksW = (w + BRICK_SIZE - 1) / BRICK_SIZE;
+    const unsigned int bricksH = (h + BRICK_SIZE - 1) / BRICK_SIZE;
+    const unsigned int b = (bk*bricksH + bj)*bricksW + bi;
+    const unsigned int kEnd = std::min((bk + 1)*BRICK_SIZE, d);
+    const unsigned int jEnd = std::min((bj + 1)*BRICK_SIZE, h);
+    const unsigned int iEnd = std::min((bi + 1)*BRICK_SIZE, w);
+
+    T values[BRICK_VOLUME];
+    T first = func(bi*BRICK_SIZE, bj*BRICK_SIZE, bk*BRICK_SIZE);
+    bool uniform = true;
+    for(auto k = bk*BRICK_SIZE; k < kEnd; k++){
+      for(auto j = bj*BRICK_SIZE; j < jEnd; j++){
+        for(auto i = bi*BRICK_SIZE; i < iEnd; i++){
+          const unsigned int local = ((k % BRICK_SIZE)*BRICK_SIZE + j % BRICK_SIZE)*BRICK_SIZE + i % BRICK_SIZE;
+          values[local] = local == 0 ? first : func(i, j, k);
+          uniform = uniform && values[local] == first;
+        }
+      }
+    }
+
+    if (uniform) {
+      delete[] bricks[b];
+      bricks[b] = nullptr;
+      brickValues[b] = first;
+      return;
+    }
+    if (!bricks[b]) {
+      bricks[b] = new T[BRICK_VOLUME];
+    }
+    for(auto k = bk*BRICK_SIZE; k < kEnd; k++){
+      for(auto j = bj*BRICK_SIZE; j < jEnd; j++){
+        for(auto i = bi*BRICK_SIZE; i < iEnd; i++){
+          const unsigned int local = ((k % BRICK_SIZE)*BRICK_SIZE + j % BRICK_SIZE)*BRICK_SIZE + i % BRICK_SIZE;
+          bricks[b][local] = values[local];
+        }
+      }
+    }
+  }
+
+  /**
+   * Set up the storage size and, for bricked grids, the per-axis offset tables.
+   * The brick offset is separable, so a cell's storage index is
+   * xOffsets[i] + yOffsets[j] + zOffsets[k].
+   */
+  void initializeLayout() {
+    const unsigned int brickVolume = BRICK_VOLUME;
+    const unsigned int bricksW = (w + BRICK_SIZE - 1) / BRICK_SIZE;
+    const unsigned int bricksH = (h + BRICK_SIZE - 1) / BRICK_SIZE;
+    const unsigned int bricksD = (d + BRICK_SIZE - 1) / BRICK_SIZE;
+    brickCount = bricksW*bricksH*bricksD;
+    bricks = nullptr;
+    brickValues = nullptr;
+    if (layout == GridLayout::FLAT) {
+      capacity = w*h*d;
+      return;
+    }
+    capacity = brickCount*brickVolume;
+
+    xOffsets.resize(w);
+    yOffsets.resize(h);
+    zOffsets.resize(d);
+    for(auto i = 0u; i < w; i++){
+      xOffsets[i] = (i / BRICK_SIZE)*brickVolume + i % BRICK_SIZE;
+    }
+    for(auto j = 0u; j < h; j++){
+      yOffsets[j] = (j / BRICK_SIZE)*bricksW*brickVolume + (j % BRICK_SIZE)*BRICK_SIZE;
+    }
+    for(auto k = 0u; k < d; k++){
+      zOffsets[k] = (k / BRICK_SIZE)*bricksW*bricksH*brickVolume + (k % BRICK_SIZE)*BRICK_SIZE*BRICK_SIZE;
+    }
+  }
+
+  /**
+   * Set up the FLAT strides and storage size for a halo of the given width.
+   */
+  void initializeHalo(unsigned int width, HaloPolicy policy) {
+    halo = layout == GridLayout::FLAT ? width : 0;
+    haloPolicy = policy;
+    strideY = w + 2*halo;
+    strideZ = strideY*(h + 2*halo);
+    haloOffset = halo*strideZ + halo*strideY + halo;
+    if (layout == GridLayout::FLAT) {
+      capacity = strideZ*(d + 2*halo);
+    }
+  }
+
+  /**
+   * Value of a ghost cell according to the halo policy.
+   */
+  T ghostValue(int i, int j, int k) const{
+    if (haloPolicy == HaloPolicy::ZERO) {
+      return T(0);
+    }
+    if (haloPolicy == HaloPolicy::REFLECT) {
+      i = i < 0 ? -1 - i : i >= int(w) ? 2*int(w) - 1 - i : i;
+      j = j < 0 ? -1 - j : j >= int(h) ? 2*int(h) - 1 - j : j;
+      k = k < 0 ? -1 - k : k >= int(d) ? 2*int(d) - 1 - k : k;
+    }
+    return clampGet(i, j, k);
+  }
+
+  unsigned int capacity, brickCount;
+  std::vector<unsigned int> xOffsets, yOffsets, zOffsets;
+
+  // sparse storage, a null brick holds brickValues[b] in every cell
+  T **bricks;
+  T *brickValues;
 };
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <grid.h>
+#include <ordinalGrid.h>
+#include <vector>
+#include <cstdint>
+
+/**
+ * Untidy priority queue of grid cells for fast marching, with the same interface
+ * as GridHeap. Cells go into buckets of BUCKET_WIDTH cells of distance and leave
+ * a bucket in any order, so pops are only sorted up to one bucket width.
+ * A cell whose distance dropped is inserted again and its older entry is skipped.
+ */
+class GridBucketQueue
+{
+public:
+
+  GridBucketQueue(unsigned int w, unsigned int h, unsigned int d, OrdinalGrid<float> *cg);
+
+  void insert(GridCoordinate coord);
+  GridCoordinate pop();
+
+  bool empty();
+  void clear();
+  void setComparisonGrid(OrdinalGrid<float> *cg);
+
+  static constexpr float BUCKET_WIDTH = 1.0f/16.0f;
+
+private:
+  struct Entry {
+    uint32_t index;
+    float key;
+  };
+
+  bool findFirst();
+  bool isStale(const Entry &entry) const;
+  GridCoordinate toCoordinate(uint32_t index) const;
+
+  std::vector<std::vector<Entry>> buckets;
+  OrdinalGrid<float> *comparisonGrid;
+  unsigned int w, h, d;
+  // every entry lies in the buckets from first to last
+  unsigned int first, last;
+
+};
@@ -16,6 +16,7 @@ public:
 
   bool empty();
   void clear();
+  void setComparisonGrid(OrdinalGrid<float> *cg);
 
 private:
   void percolateUp(int);
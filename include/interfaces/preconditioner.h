@@ -0,0 +1,9 @@
+#pragma once
+#include <vector>
+class State;
+struct PressureStencil;
+struct Preconditioner{
+	virtual ~Preconditioner(){}
+	virtual void build(State const* const state, PressureStencil const* const stencil) = 0;
+	virtual void apply(const std::vector<double> &r, std::vector<double> &z) = 0;
+};
@@ -6,8 +6,33 @@
 #include <grid.h>
 #include <signedDistanceFunction.h>
 #include <limits>
+#include <vector>
 class VelocityGrid;
-class GridHeap;
+class GridBucketQueue;
+
+/**
+ * Layout of the distance and closest point fields of new level sets.
+ * Defaults to SPARSE when compiled with PINK_FLUID_SPARSE_LEVEL_SETS,
+ * so that only bricks near the interface are allocated.
+ */
+inline GridLayout& levelSetLayout() {
+#ifdef PINK_FLUID_SPARSE_LEVEL_SETS
+  static GridLayout layout = GridLayout::SPARSE;
+#else
+  static GridLayout layout = defaultGridLayout();
+#endif
+  return layout;
+}
+
+/**
+ * How LevelSet::reinitialize rebuilds the distance field from the interface.
+ * FAST_MARCHING grows it in distance order from a bucket queue, on one thread.
+ * FAST_SWEEPING runs Gauss-Seidel sweeps in the 8 axis orderings, each over
+ * diagonal wavefronts of independent cells, in parallel.
+ */
+enum class ReinitializationMethod {
+  FAST_MARCHING, FAST_SWEEPING
+};
 
 class LevelSet{
  public:
@@ -26,8 +51,47 @@ class LevelSet{
   void setCellTypeGrid(Grid<CellType> const* const);
 
   void reinitialize();
+  void setReinitializationMethod(ReinitializationMethod method);
+  ReinitializationMethod getReinitializationMethod() const;
+  /**
+   * Whether the last fast sweeping reinitialization repeated its sweeps until
+   * nothing changed, rather than stopping at the cap of w + h + d rounds.
+   */
+  bool getSweepConverged() const;
+
+  /**
+   * Distance from the interface at which fast marching stops. Cells further away
+   * get +-bandWidth and the closest point outsideBand(). Unlimited by default.
+   */
+  void setBandWidth(float bandWidth);
+  float getBandWidth() const;
+
+  /**
+   * Re-march only the tiles whose cells changed sign or drifted since they were
+   * last reinitialized, plus a halo of the band width, and keep the distances and
+   * closest points elsewhere. Needs fast marching and a finite band, otherwise
+   * the whole grid is reinitialized. Off by default.
+   */
+  void setIncrementalReinitialization(bool incremental);
+  bool getIncrementalReinitialization() const;
+
+  /**
+   * Closest point of the cells that fast marching did not reach within the band.
+   */
+  static glm::vec3 outsideBand() {
+    return glm::vec3(-INF);
+  }
+  static bool isOutsideBand(const glm::vec3 &closestPoint) {
+    return closestPoint.x == -INF;
+  }
   void updateCellTypes();
   float getVolumeError();
+
+  /**
+   * Inclusive box around the FLUID cells as of the last updateCellTypes.
+   * @return false if there are no fluid cells
+   */
+  bool getFluidBounds(GridCoordinate &lower, GridCoordinate &upper) const;
   
   OrdinalGrid<float> *distanceGrid;
   Grid<CellType> *cellTypeGrid;
@@ -39,16 +103,22 @@ class LevelSet{
   void merge(LevelSet *ls);
 
  private:
+  void updateInterfaceCells();
   void updateInterfaceNeighbors();
-  void updateInterfaceNeighborCell(unsigned int i, unsigned int j, unsigned int k);
+  float updateInterfaceNeighborCell(unsigned int i, unsigned int j, unsigned int k);
   void updateNeighborsFrom(GridCoordinate from);
 
   void updateFromCell(GridCoordinate to, GridCoordinate from);
   void updateFromCell(unsigned int xTo, unsigned int yTo, unsigned int xFrom, unsigned int yFrom);
 
-  void updateCurrentVolume();
-
   void fastMarch();
+  void fillOutsideBand();
+  void markChangedTiles();
+  void updateRegionInterfaceNeighbors();
+  void rememberReinitializedDistances(bool regionOnly);
+  bool inRegion(unsigned int i, unsigned int j, unsigned int k) const;
+  void fastSweep();
+  bool sweep(int si, int sj, int sk);
 
   static bool heapCompare(GridCoordinate &a, GridCoordinate &b);
 
@@ -57,15 +127,37 @@ class LevelSet{
   void initializeDistanceGrid(SignedDistanceFunction sdf);
   void clampInfiniteCells();
 
+  void writeCellTypes(std::ostream& stream);
+  void readCellTypes(std::istream& stream);
+
   static constexpr float INF = 9999999.0f;
+  // incremental reinitialization works on tiles of TILE_SIZE^3 cells
+  static constexpr unsigned int TILE_SIZE = 8;
+  // a tile is re-marched once a cell moved this many cells away from its reinitialized distance
+  static constexpr float DRIFT_TOLERANCE = 0.25f;
 
   Grid<bool> *doneGrid;
   Grid<glm::vec3> *closestPointGrid;
-  GridHeap *gridHeap;
+  GridBucketQueue *marchQueue;
   unsigned int heapEnd;
+  ReinitializationMethod reinitializationMethod;
+  float bandWidth;
+  bool incremental;
+  // distances right after the last reinitialization of each tile, null until the first
+  OrdinalGrid<float> *reinitializedDistanceGrid;
+  // per tile, whether the current reinitialization re-marches it
+  std::vector<char> regionTiles;
+  unsigned int tilesW, tilesH, tilesD;
+  // fast marching leaves the cells outside the region alone
+  bool marchingRegion;
+  // flat k*w*h + j*w + i copies of the distances and closest points while sweeping
+  std::vector<float> sweepDistances;
+  std::vector<glm::vec3> sweepPoints;
+  bool sweepConverged;
   OrdinalGrid<float> *oldDistanceGrid;
 
   int w, h, d;
   float targetVolume, currentVolume;
+  GridCoordinate fluidLower, fluidUpper;
 
 };
@@ -0,0 +1,33 @@
+#pragma once
+#include <interfaces/preconditioner.h>
+#include <vector>
+
+/**
+ * Modified incomplete Cholesky, level zero, on the lexicographic cell order.
+ * Sequential by default. Level scheduled, a cell only depends on its -x, -y
+ * and -z neighbours, so all cells with the same i + j + k are independent and
+ * each such level is built and solved in parallel. Both give the same
+ * preconditioner.
+ */
+class MICPreconditioner : public Preconditioner{
+public:
+  MICPreconditioner(bool levelScheduled = false);
+  virtual void build(State const* const state, PressureStencil const* const stencil);
+  virtual void apply(const std::vector<double> &r, std::vector<double> &z);
+
+private:
+  void buildLevels();
+  inline void factor(int n);
+  inline void forward(int n, const std::vector<double> &r, std::vector<double> &z) const;
+  inline void backward(int n, std::vector<double> &z) const;
+
+  PressureStencil const *stencil;
+  std::vector<double> precon;
+
+  bool levelScheduled;
+  // fluid cells sorted by i + j + k, level l is levelCells[levelStart[l]] up to levelStart[l + 1]
+  std::vector<int> levelStart, levelCells;
+
+  static constexpr double MIC_TUNING = 0.97;
+  static constexpr double MIC_SAFETY = 0.25;
+};
@@ -1,6 +1,7 @@
 #pragma once
 #include <interfaces/pressureSolver.h>
 #include <pcgsolver/pcg_solver.h>
+#include <fluidCellIndex.h>
 #include <vector>
 
 template<class T>
@@ -14,7 +15,9 @@ class MICSolver : public PressureSolver{
 		virtual bool solve(OrdinalGrid<float> const* const divergenceGrid, State const* const state, OrdinalGrid<double> *pressureGrid, const float dt);
 		void fillA(SparseMatrix<double> *aMatrix, State const* const state, const float dt);
 		void fillB(std::vector<double> *bVector, OrdinalGrid<float> const* const divergenceGrid);
+		const FluidCellIndex& getFluidCells() const;
 	private:
+		FluidCellIndex fluidCells;
 		PCGSolver<double> solver;
 		SparseMatrix<double> *aMatrix;
 		std::vector<double> *xVector;
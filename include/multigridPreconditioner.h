@@ -0,0 +1,50 @@
+#pragma once
+#include <interfaces/preconditioner.h>
+#include <state.h>
+#include <vector>
+
+template<typename T>
+class Grid;
+
+/**
+ * One geometric multigrid V-cycle as a preconditioner for conjugate gradient.
+ * Each level halves the grid. A coarse cell is EMPTY if any of its children
+ * is, otherwise FLUID if any child is and SOLID if none are, so the coarse
+ * levels keep the free surface and solid walls of the fine level.
+ * Smoothing is red-black Gauss-Seidel, run in reverse order on the way up,
+ * which keeps the V-cycle symmetric as conjugate gradient requires.
+ * Every level works on the fluid cells of its own PressureStencil.
+ */
+class MultigridPreconditioner : public Preconditioner{
+public:
+  MultigridPreconditioner(unsigned int smoothingSweeps = 2, unsigned int coarseSweeps = 20);
+  ~MultigridPreconditioner();
+  virtual void build(State const* const state, PressureStencil const* const stencil);
+  virtual void apply(const std::vector<double> &r, std::vector<double> &z);
+
+  unsigned int getLevelCount() const;
+
+  static constexpr unsigned int COARSEST_SIZE = 4;
+
+private:
+  struct Level {
+    // cell types and stencil of the coarse levels, owned by the preconditioner
+    Grid<CellType> *cellTypes;
+    PressureStencil *coarseStencil;
+    PressureStencil const *stencil;
+    std::vector<double> x, b, r;
+    std::vector<int> red, black;
+  };
+
+  void resize(unsigned int w, unsigned int h, unsigned int d);
+  void clearLevels();
+  void coarsen(Grid<CellType> const* const fine, Grid<CellType> *coarse);
+  void vCycle(unsigned int l);
+  void smooth(Level &level, const std::vector<int> &colour);
+  void computeResidual(Level &level);
+  void restrictResidual(unsigned int l);
+  void prolongAndCorrect(unsigned int l);
+
+  unsigned int smoothingSweeps, coarseSweeps;
+  std::vector<Level> levels;
+};
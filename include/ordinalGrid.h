@@ -14,8 +14,9 @@ public:
    * Constructor.
    * @param w width
    * @param h height
+   * @param layout memory layout of the cells
    */
- OrdinalGrid(unsigned int w, unsigned int h, unsigned int d) : Grid<T>(w, h, d) {};
+ OrdinalGrid(unsigned int w, unsigned int h, unsigned int d, GridLayout layout = defaultGridLayout()) : Grid<T>(w, h, d, layout) {};
 
  /**
    * Get the linearly interpolated value of the stored quantity.
@@ -76,6 +77,9 @@ public:
    * @param k, the position along the z axis (d)
    */
   T getCrerp(float i, float j, float k) const{
+    if (this->halo > 0) {
+      return getCrerpHalo(i, j, k);
+    }
     unsigned int i0 = floor(i)-1;
     unsigned int i1 = floor(i);
     unsigned int i2 = ceil(i);
@@ -202,6 +206,109 @@ public:
     
     return crer(v0,v1,v2,v3,ti);
   }
+
+  /**
+   * Catmull-Rom interpolation reading straight from a haloed grid.
+   * Stencil indices are clamped into the halo instead of checking every sample,
+   * so with a ZERO halo this matches the safeGet path of getCrerp.
+   */
+  T getCrerpHalo(float i, float j, float k) const{
+    int xs[4], ys[4], zs[4];
+    crerpStencil(i, j, k, xs, ys, zs);
+    return crerpAt(xs, ys, zs, i - floor(i), j - floor(j), k - floor(k));
+  }
+
+  /**
+   * Batched getLerp, values[n] = getLerp(positions[n]) for n < count.
+   * Samples are processed in blocks, the weights and storage offsets of a block
+   * are computed in one simd loop and the values gathered in another, so both
+   * vectorize for the instruction set the compiler targets.
+   */
+  void getLerp(const glm::vec3 *positions, T *values, unsigned int count) const{
+    if (this->layout != GridLayout::FLAT) {
+      for (unsigned int n = 0; n < count; n++) {
+        values[n] = getLerp(positions[n]);
+      }
+      return;
+    }
+    const float maxI = this->w - 1;
+    const float maxJ = this->h - 1;
+    const float maxK = this->d - 1;
+    const int strideY = this->strideY;
+    const int strideZ = this->strideZ;
+    const T *origin = this->quantities + this->haloOffset;
+
+    for (unsigned int start = 0; start < count; start += SAMPLE_BLOCK) {
+      const unsigned int block = count - start < SAMPLE_BLOCK ? count - start : SAMPLE_BLOCK;
+      int base[SAMPLE_BLOCK], di[SAMPLE_BLOCK], dj[SAMPLE_BLOCK], dk[SAMPLE_BLOCK];
+      float ti[SAMPLE_BLOCK], tj[SAMPLE_BLOCK], tk[SAMPLE_BLOCK];
+
+      #pragma omp simd
+      for (unsigned int n = 0; n < block; n++) {
+        const glm::vec3 p = positions[start + n];
+        // std::min(max, nan) is max, so stray NaN positions stay inside the grid
+        const float i = std::max(std::min(maxI, p.x), 0.0f);
+        const float j = std::max(std::min(maxJ, p.y), 0.0f);
+        const float k = std::max(std::min(maxK, p.z), 0.0f);
+        const float fi = floor(i), fj = floor(j), fk = floor(k);
+        base[n] = int(fk)*strideZ + int(fj)*strideY + int(fi);
+        di[n] = int(ceil(i)) - int(fi);
+        dj[n] = (int(ceil(j)) - int(fj))*strideY;
+        dk[n] = (int(ceil(k)) - int(fk))*strideZ;
+        ti[n] = i - fi;
+        tj[n] = j - fj;
+        tk[n] = k - fk;
+      }
+
+      #pragma omp simd
+      for (unsigned int n = 0; n < block; n++) {
+        const T *c = origin + base[n];
+        T v00 = lerp(c[0], c[dk[n]], tk[n]);
+        T v01 = lerp(c[dj[n]], c[dj[n] + dk[n]], tk[n]);
+        T v10 = lerp(c[di[n]], c[di[n] + dk[n]], tk[n]);
+        T v11 = lerp(c[di[n] + dj[n]], c[di[n] + dj[n] + dk[n]], tk[n]);
+
+        T v0 = lerp(v00, v01, tj[n]);
+        T v1 = lerp(v10, v11, tj[n]);
+
+        values[start + n] = lerp(v0, v1, ti[n]);
+      }
+    }
+  }
+
+  /**
+   * Batched getCrerp, values[n] = getCrerp(positions[n]) for n < count.
+   * Vectorized like the batched getLerp on haloed FLAT grids, other grids
+   * are sampled one position at a time.
+   */
+  void getCrerp(const glm::vec3 *positions, T *values, unsigned int count) const{
+    if (this->layout != GridLayout::FLAT || this->halo == 0) {
+      for (unsigned int n = 0; n < count; n++) {
+        values[n] = getCrerp(positions[n]);
+      }
+      return;
+    }
+
+    for (unsigned int start = 0; start < count; start += SAMPLE_BLOCK) {
+      const unsigned int block = count - start < SAMPLE_BLOCK ? count - start : SAMPLE_BLOCK;
+      int xs[SAMPLE_BLOCK][4], ys[SAMPLE_BLOCK][4], zs[SAMPLE_BLOCK][4];
+      float ti[SAMPLE_BLOCK], tj[SAMPLE_BLOCK], tk[SAMPLE_BLOCK];
+
+      #pragma omp simd
+      for (unsigned int n = 0; n < block; n++) {
+        const glm::vec3 p = positions[start + n];
+        crerpStencil(p.x, p.y, p.z, xs[n], ys[n], zs[n]);
+        ti[n] = p.x - floor(p.x);
+        tj[n] = p.y - floor(p.y);
+        tk[n] = p.z - floor(p.z);
+      }
+
+      for (unsigned int n = 0; n < block; n++) {
+        values[start + n] = crerpAt(xs[n], ys[n], zs[n], ti[n], tj[n], tk[n]);
+      }
+    }
+  }
+
   ~OrdinalGrid(){
   }
   /**
@@ -222,6 +329,43 @@ public:
   }
 
  private:
+  static constexpr unsigned int SAMPLE_BLOCK = 16;
+
+  /**
+   * Catmull-Rom stencil of a haloed grid around (i, j, k), clamped into the halo.
+   * xs are x indices, ys and zs are already multiplied by the y and z strides.
+   */
+  inline void crerpStencil(float i, float j, float k, int xs[4], int ys[4], int zs[4]) const{
+    const int g = this->halo;
+    const int fi = floor(i), fj = floor(j), fk = floor(k);
+    const int ci = ceil(i), cj = ceil(j), ck = ceil(k);
+    const int is[4] = {fi - 1, fi, ci, ci + 1};
+    const int js[4] = {fj - 1, fj, cj, cj + 1};
+    const int ks[4] = {fk - 1, fk, ck, ck + 1};
+    for (int n = 0; n < 4; n++) {
+      xs[n] = glm::clamp(is[n], -g, int(this->w) - 1 + g);
+      ys[n] = glm::clamp(js[n], -g, int(this->h) - 1 + g)*this->strideY;
+      zs[n] = glm::clamp(ks[n], -g, int(this->d) - 1 + g)*this->strideZ;
+    }
+  }
+
+  /**
+   * Catmull-Rom interpolation over a stencil from crerpStencil.
+   */
+  inline T crerpAt(const int xs[4], const int ys[4], const int zs[4], float ti, float tj, float tk) const{
+    const T *origin = this->quantities + this->haloOffset;
+    T alongI[4];
+    for (int a = 0; a < 4; a++) {
+      T alongJ[4];
+      for (int b = 0; b < 4; b++) {
+        const T *row = origin + xs[a] + ys[b];
+        alongJ[b] = crer(row[zs[0]], row[zs[1]], row[zs[2]], row[zs[3]], tk);
+      }
+      alongI[a] = crer(alongJ[0], alongJ[1], alongJ[2], alongJ[3], tj);
+    }
+    return crer(alongI[0], alongI[1], alongI[2], alongI[3], ti);
+  }
+
   /**
    * Linear interpolation.
    * @param a The first value
@@ -1,7 +1,6 @@
 #pragma once
 
 #include <vector>
-#include <stack>
 #include <glm/glm.hpp>
 
 struct Particle;
@@ -10,6 +9,7 @@ class OrdinalGrid;
 template<typename T>
 class Grid;
 struct VelocityGrid;
+class VelocityCache;
 class BubbleTracker;
 class State;
 
@@ -21,6 +21,7 @@ public:
 
   void reinitializeParticles(OrdinalGrid<float> const* distance);
   void advect(VelocityGrid const* velocities, float dt);
+  void advect(VelocityCache const* velocityCache, float dt);
 
   void feedEscaped(BubbleTracker* bt, State *state);
 
@@ -29,8 +30,6 @@ public:
   std::vector<Particle> getParticles() const;
 private:
 
-  void insertParticle(glm::vec3 pos, float radius);
-
   glm::vec3 jitterCoordinate(glm::vec3 coord);
 
   void resetParticleCount();
@@ -41,9 +40,12 @@ private:
   unsigned particlesPerCell;
 
   unsigned w, h, d;
-  std::vector<Particle*> *interfaceParticles;
-  std::stack<Particle*> *deadParticles;
-  std::vector<Particle*> *escapedParticles;
+  // the alive interface particles, packed: particle n is at positions[n] with radius phis[n]
+  std::vector<glm::vec3> positions;
+  std::vector<float> phis;
+  // per particle scratch for the batched samplers
+  std::vector<glm::vec3> sampledVelocities;
+  std::vector<float> sampledDistances;
   Grid<float> *corrPlus, *corrMinus;
   Grid<unsigned> *particleCount;
 };
@@ -0,0 +1,28 @@
+#pragma once
+#include <fluidCellIndex.h>
+#include <vector>
+
+class SolidFaces;
+
+/**
+ * The 7-point pressure operator over the fluid cells of a state, numbered by a
+ * FluidCellIndex. Fluid neighbours couple with -scale, air neighbours and the
+ * domain boundary only add to the diagonal and solid neighbours are left out.
+ */
+struct PressureStencil{
+  void build(State const* const state, const float dt);
+  /**
+   * Solid faces are read from solidFaces when given, else from the cell types.
+   */
+  void build(Grid<CellType> const* const cellTypeGrid, const double scale, SolidFaces const* const solidFaces = nullptr);
+  void apply(const std::vector<double> &x, std::vector<double> &result) const;
+  unsigned int size() const;
+
+  FluidCellIndex fluidCells;
+  double scale;
+
+  // plusI[n] couples fluid cell n with its +x neighbour nextI[n], and so on
+  std::vector<double> diag, plusI, plusJ, plusK;
+  // fluid neighbours of every fluid cell, FluidCellIndex::NOT_FLUID where there is none
+  std::vector<int> previousI, previousJ, previousK, nextI, nextJ, nextK;
+};
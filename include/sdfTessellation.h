@@ -7,10 +7,15 @@
 class SdfTessellation {
  public:
   SdfTessellation(const OrdinalGrid<float> *sdf);
+  /**
+   * Only tessellate the cubes with a corner from lower to upper, inclusive.
+   */
+  SdfTessellation(const OrdinalGrid<float> *sdf, GridCoordinate lower, GridCoordinate upper);
   std::vector<glm::vec3> getVertices();
   std::vector<Face> getFaces();
  private: 
   const OrdinalGrid<float> *sdf;
+  GridCoordinate lower, upper;
   void tessellate();
   bool  tessellated = false;
   std::vector<glm::vec3> vertices;
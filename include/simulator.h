@@ -5,18 +5,25 @@ template<typename T>
 class Grid;
 class State;
 struct PressureSolver;
+struct Preconditioner;
 struct VelocityGrid;
 class ParticleTracker;
 class BubbleTracker;
+class SolidFaces;
+class VelocityCache;
 
 #include <glm/glm.hpp>
 #include <util.h>
 #include <vector>
+#include <cstdint>
+#include <grid.h>
 #include <bubble.h>
 
+enum CellType : int8_t;
+
 class Simulator{
 public:
-  Simulator(const State& initialState, float scale = 1.0f, bool usePls = true, bool useBubbleSpawning = true);
+  Simulator(const State& initialState, float scale = 1.0f, bool usePls = true, bool useBubbleSpawning = true, bool warmStartPressure = false, Preconditioner *pressurePreconditioner = nullptr);
   ~Simulator();
 
   void addBubbles(std::vector<Bubble>& bubbles);
@@ -30,15 +37,49 @@ public:
   // glm::vec3 backTrackMid(State const * readFrom, GridCoordinate x, float dt);
   void advect(State const * readFrom, State * writeTo, float dt);
 
-  // ext. forces
-  void applyGravity(State *state, glm::vec3 g, float deltaT);
-
-  // pressure
-  void calculateNegativeDivergence(State const* readFrom, OrdinalGrid<float> *toDivergenceGrid);
+  // pressure, with gravity as the only external force
+  void calculateNegativeDivergence(State const* readFrom, OrdinalGrid<float> *toDivergenceGrid, glm::vec3 g, float deltaT);
   
-  void gradientSubtraction(State *state, float dt);
-  void initializeExtrapolation(State *stateFrom);
-  void extrapolateVelocity(State *stateFrom, State *stateTo);
+  glm::vec3 gradientSubtraction(State *state, glm::vec3 g, float dt);
+  void extrapolateVelocity(State *state, float dt);
+
+  /**
+   * Fewest layers of faces around the fluid that get extrapolated velocities. A step
+   * extrapolates more when its fastest face travels further, as advection looks back
+   * that far plus one face for the interpolation.
+   */
+  void setExtrapolationDepth(unsigned int layers);
+  unsigned int getExtrapolationDepth() const;
+
+  /**
+   * Limit advection, gravity, divergence, projection and the maximum velocity to
+   * the cells the fluid can reach in a step. On by default.
+   */
+  void setRestrictToActiveRegion(bool enabled);
+  bool getRestrictToActiveRegion() const;
+  void getActiveRegion(GridCoordinate &lower, GridCoordinate &upper) const;
+  /**
+   * Fraction of the cells of all steps so far that were skipped as outside the active region.
+   */
+  float getSkippedFraction() const;
+
+  /**
+   * Backtrace the advection, particles and bubbles through velocities averaged to the
+   * cell centres once per step, one lookup per sample instead of three. Off by default,
+   * the averaged velocities are smoother than the faces between the cell centres.
+   */
+  void setUseVelocityCache(bool enabled);
+  bool getUseVelocityCache() const;
+
+  /**
+   * Advect the distances only within this distance of the interface, plus the distance
+   * it travels in a step. Other cells keep their distance until reinitialization.
+   * Needs the particle level set, which reinitializes every step. Unlimited by default,
+   * widths below MIN_DISTANCE_ADVECTION_BAND are raised to it.
+   */
+  void setDistanceAdvectionBand(float width);
+  float getDistanceAdvectionBand() const;
+  static constexpr float MIN_DISTANCE_ADVECTION_BAND = 1.0f;
 
   OrdinalGrid<double>* resetPressureGrid();
   OrdinalGrid<float>* getDivergenceGrid();  
@@ -54,12 +95,40 @@ private:
   OrdinalGrid<float> *divergenceGrid;
   OrdinalGrid<double> *pressureGridFrom, *pressureGridTo;
   PressureSolver *pressureSolver, *jacobiSolver;
+  void extrapolateVelocityComponent(OrdinalGrid<float> *velocities, Grid<CellType> const* cellTypeGrid,
+                                    GridCoordinate axis, GridCoordinate lower, GridCoordinate upper,
+                                    unsigned int depth);
+  void updateActiveRegion(State const* state, float dt);
+  float subtractPressureGradient(OrdinalGrid<float> *velocities, Grid<CellType> const* cellTypeGrid,
+                                 SolidFaces const* solidFaces, GridCoordinate axis, uint8_t solidBefore,
+                                 float acceleration, float scale);
+
   float deltaT;
   float gridSize;
   bool usePls;
   bool useBubbleSpawning;
 
   static constexpr unsigned int PARTICLES_PER_CELL = 64;
+  static constexpr unsigned int EXTRAPOLATION_DEPTH = 4;
+  // layer of every face while extrapolating, and the faces of the current layer
+  static constexpr uint8_t UNKNOWN_FACE = 255, FIXED_FACE = 254;
+  static constexpr unsigned int MAX_EXTRAPOLATION_DEPTH = FIXED_FACE - 1;
+  unsigned int extrapolationDepth;
+  float distanceAdvectionBand;
+  std::vector<uint8_t> extrapolationLayers;
+  std::vector<int> extrapolationFrontier;
+  // cells beyond the fluid travel distance that stay active, for the interpolation stencils
+  static constexpr int ACTIVE_REGION_PADDING = 2;
+  // farthest cell of a Catmull-Rom stencil from its sample point, 2*sqrt(3)
+  static constexpr float CRERP_STENCIL_REACH = 3.4641016f;
+  bool restrictToActiveRegion;
+  GridCoordinate activeLower, activeUpper;
+  unsigned long long activeCells, domainCells;
+  // largest face speeds of stateFrom along each axis, from the projection that made it
+  glm::vec3 maxFaceVelocity;
+  bool maxFaceVelocityKnown;
+  // cell-centred velocities of stateFrom, nullptr unless enabled
+  VelocityCache *velocityCache;
   ParticleTracker *pTracker;
   BubbleTracker *bTracker;
 };
@@ -0,0 +1,42 @@
+#pragma once
+#include <grid.h>
+#include <state.h>
+#include <cstdint>
+
+/**
+ * Which faces of every cell are closed by a SOLID neighbour, one bit per face,
+ * and whether the cell is solid itself. Solids do not move during a run, so the
+ * masks are built once from the cell types and rebuilt only when the solids change.
+ * Faces on the domain boundary are open, like faces to air.
+ */
+class SolidFaces {
+public:
+  SolidFaces(unsigned int w, unsigned int h, unsigned int d);
+  SolidFaces(const SolidFaces& origin);
+  ~SolidFaces();
+
+  void build(Grid<CellType> const* const cellTypeGrid);
+
+  uint8_t get(unsigned int i, unsigned int j, unsigned int k) const{
+    return masks->get(i, j, k);
+  }
+
+  /**
+   * The mask of a cell worked out from the cell types, for grids without SolidFaces.
+   */
+  static uint8_t maskAt(Grid<CellType> const* const cellTypeGrid, int i, int j, int k);
+
+  /**
+   * Faces of a cell through which fluid can flow. Solids fill whole cells, so the
+   * open fraction of every face is 0 or 1 and the open faces are a count.
+   */
+  static int openFaces(uint8_t mask);
+
+  // closed faces towards i - 1, i + 1, j - 1, j + 1, k - 1 and k + 1
+  static constexpr uint8_t LEFT = 1, RIGHT = 2, UP = 4, DOWN = 8, FRONT = 16, BACK = 32;
+  static constexpr uint8_t ALL_FACES = 63;
+  static constexpr uint8_t SOLID_CELL = 64;
+
+private:
+  Grid<uint8_t> *masks;
+};
@@ -1,6 +1,9 @@
 #pragma once
 #include <glm/glm.hpp>
 #include <vector>
+#include <stack>
+#include <cstdint>
+#include <grid.h>
 #include <particleTracker.h>
 #include <bubble.h>
 
@@ -10,10 +13,14 @@ template<typename T>
 class Grid;
 
 class LevelSet;
+class SolidFaces;
 class Simulator;
 struct VelocityGrid;
 
-enum CellType{
+/**
+ * Stored in one byte, the solver, extrapolation and projection loops read it for every cell.
+ */
+enum CellType : int8_t {
   SOLID = -1, EMPTY = 0, FLUID = 1
 };
 
@@ -28,6 +35,8 @@ public:
 
   OrdinalGrid<float> const *const getSignedDistanceGrid() const;
   Grid<glm::vec3> const *const getClosestPointGrid() const;
+  SolidFaces const *getSolidFaces() const;
+  bool getFluidBounds(GridCoordinate &lower, GridCoordinate &upper) const;
   
   void setCellTypeGrid(Grid<CellType> const* const);
   void setVelocityGrid(VelocityGrid const* const);
@@ -46,11 +55,14 @@ public:
   unsigned int getFrameNumber() const;
 private:
   void resetVelocityGrids();
+  void updateSolidFaces();
   
   VelocityGrid *velocityGrid;
   unsigned int w, h, d;
   unsigned int frameNumber;
   LevelSet *levelSet;
+  // rebuilt whenever the cell types are replaced, the only time solids change
+  SolidFaces *solidFaces;
 
   int nextBubbleId = 0;
   std::vector<Bubble> bubbles;
@@ -0,0 +1,41 @@
+#pragma once
+#include <interfaces/pressureSolver.h>
+#include <interfaces/preconditioner.h>
+#include <pressureStencil.h>
+#include <vector>
+
+/**
+ * Preconditioned conjugate gradient on the 7-point pressure stencil, without
+ * assembling a sparse matrix. Only fluid cells are unknowns. The preconditioner
+ * is owned by the solver and defaults to MIC(0).
+ * With warm start the solve begins from the pressure already in the pressure
+ * grid, the previous solution when the grid is reused between steps.
+ */
+class StencilPCGSolver : public PressureSolver{
+public:
+  StencilPCGSolver(Preconditioner *preconditioner = nullptr, double tolerance = 1e-6, int maxIterations = 100);
+  ~StencilPCGSolver();
+  virtual bool solve(OrdinalGrid<float> const* const divergenceGrid, State const* const state, OrdinalGrid<double> *pressureGrid, const float dt);
+
+  void setPreconditioner(Preconditioner *preconditioner);
+  void setWarmStart(bool warmStart);
+
+  int getIterations() const;
+  const PressureStencil& getStencil() const;
+
+private:
+  void warmStartPressure(OrdinalGrid<double> const* const pressureGrid);
+  double dot(const std::vector<double> &a, const std::vector<double> &b) const;
+  double absMax(const std::vector<double> &a) const;
+  void addScaled(double alpha, const std::vector<double> &x, std::vector<double> &y) const;
+
+  Preconditioner *preconditioner;
+  double tolerance;
+  int maxIterations;
+  int iterations;
+  bool warmStart;
+
+  PressureStencil stencil;
+  FluidCellIndex previousFluidCells;
+  std::vector<double> pressure, residual, z, search;
+};
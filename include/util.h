@@ -4,6 +4,7 @@
 #include <glm/glm.hpp>
 
 struct VelocityGrid;
+class VelocityCache;
 
 namespace util {
 	namespace advect{
@@ -22,6 +23,33 @@ namespace util {
    }
    
    glm::vec3 backTrack(VelocityGrid const* const velocityGrid, int i, int j, int k, float dt);
+
+    /**
+     * Batched backtraces of the row of cells (i, j, k) to (i + count - 1, j, k).
+     * @param positions count positions to copy new values from
+     */
+   namespace mac{
+   	void backTrackRowU(VelocityGrid const* const velocityGrid, int i, int j, int k, unsigned int count, float dt, glm::vec3 *positions);
+   	void backTrackRowV(VelocityGrid const* const velocityGrid, int i, int j, int k, unsigned int count, float dt, glm::vec3 *positions);
+   	void backTrackRowW(VelocityGrid const* const velocityGrid, int i, int j, int k, unsigned int count, float dt, glm::vec3 *positions);
+   }
+
+   void backTrackRow(VelocityGrid const* const velocityGrid, int i, int j, int k, unsigned int count, float dt, glm::vec3 *positions);
+
+    /**
+     * The same backtraces through cell-centred velocities, one lookup per sample.
+     */
+   namespace mac{
+   	glm::vec3 backTrackU(VelocityCache const* velocityCache, int i, int j, int k, float dt);
+   	glm::vec3 backTrackV(VelocityCache const* velocityCache, int i, int j, int k, float dt);
+   	glm::vec3 backTrackW(VelocityCache const* velocityCache, int i, int j, int k, float dt);
+   	void backTrackRowU(VelocityCache const* velocityCache, int i, int j, int k, unsigned int count, float dt, glm::vec3 *positions);
+   	void backTrackRowV(VelocityCache const* velocityCache, int i, int j, int k, unsigned int count, float dt, glm::vec3 *positions);
+   	void backTrackRowW(VelocityCache const* velocityCache, int i, int j, int k, unsigned int count, float dt, glm::vec3 *positions);
+   }
+
+   glm::vec3 backTrack(VelocityCache const* velocityCache, int i, int j, int k, float dt);
+   void backTrackRow(VelocityCache const* velocityCache, int i, int j, int k, unsigned int count, float dt, glm::vec3 *positions);
   }
 } // util
 #endif 
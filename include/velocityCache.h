@@ -0,0 +1,29 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <grid.h>
+
+template<typename T>
+class OrdinalGrid;
+struct VelocityGrid;
+
+/**
+ * Velocities of a VelocityGrid averaged to the cell centres, one vec3 per cell, so that
+ * a velocity is sampled with one trilinear lookup instead of one for each component.
+ * Away from the cell centres it is smoother than sampling the faces, and it only
+ * follows the velocity grid when updated.
+ */
+class VelocityCache {
+public:
+  VelocityCache(unsigned int w, unsigned int h, unsigned int d);
+  ~VelocityCache();
+
+  void update(VelocityGrid const* velocities);
+  void update(VelocityGrid const* velocities, GridCoordinate lower, GridCoordinate upper);
+
+  glm::vec3 sampleVelocity(glm::vec3 p) const;
+  void sampleVelocity(const glm::vec3 *positions, glm::vec3 *values, unsigned int count) const;
+
+private:
+  unsigned int w, h, d;
+  OrdinalGrid<glm::vec3> *cellVelocities;
+};
@@ -9,6 +9,9 @@ struct VelocityGrid{
   
   glm::vec3 getCell(unsigned int i, unsigned int j, unsigned int k) const;
   glm::vec3 getLerp(glm::vec3 p) const;
+  void getLerp(const glm::vec3 *positions, glm::vec3 *values, unsigned int count) const;
+  void getLerp(const glm::vec3 *positions, glm::vec3 *values, unsigned int count,
+               glm::vec3 dispU, glm::vec3 dispV, glm::vec3 dispW) const;
   OrdinalGrid<float> *u, *v, *w;
 
   std::ostream& write(std::ostream&);
@@ -1,6 +1,7 @@
 #include <bubbleTracker.h>
 
 #include <velocityGrid.h>
+#include <velocityCache.h>
 #include <ordinalGrid.h>
 #include <stdlib.h>
 #include <glm/ext.hpp>
@@ -50,7 +51,11 @@ void BubbleTracker::spawnBubble(State *state, glm::vec3 p, float r, glm::vec3 v)
   state->addBubble(b);
 }
 
-void BubbleTracker::advect(State *stateFrom, State *stateTo, OrdinalGrid<double> *pressures, glm::vec3 g, float dt) {
+/**
+ * Move the bubbles with the fluid around them, sampled from velocityCache if given.
+ */
+void BubbleTracker::advect(State *stateFrom, State *stateTo, OrdinalGrid<double> *pressures, glm::vec3 g, float dt,
+                           VelocityCache const* velocityCache) {
   // copy whole bubble state to new state.
   stateTo->bubbles = stateFrom->bubbles;
   stateTo->deadBubbleIndices = stateFrom->deadBubbleIndices;
@@ -63,6 +68,18 @@ void BubbleTracker::advect(State *stateFrom, State *stateTo, OrdinalGrid<double>
   std::stack<int> &deadBubbleIndices = stateTo->deadBubbleIndices;
   int nextBubbleId = stateTo->nextBubbleId;
 
+  // sample the fluid velocity at all bubbles in one batch
+  std::vector<glm::vec3> positions(bubbles.size());
+  std::vector<glm::vec3> fluidVelocities(bubbles.size());
+  for (auto idx = 0u; idx < bubbles.size(); idx++) {
+    positions[idx] = bubbles[idx].position;
+  }
+  if (velocityCache) {
+    velocityCache->sampleVelocity(positions.data(), fluidVelocities.data(), bubbles.size());
+  } else {
+    velocities->getLerp(positions.data(), fluidVelocities.data(), bubbles.size());
+  }
+
   for (int idx = 0; idx < bubbles.size(); idx++) {
     Bubble &b = bubbles[idx];
 
@@ -71,7 +88,7 @@ void BubbleTracker::advect(State *stateFrom, State *stateTo, OrdinalGrid<double>
     }
 
     glm::vec3 pos = b.position;
-    glm::vec3 fluidVelocity = velocities->getLerp(pos);
+    glm::vec3 fluidVelocity = fluidVelocities[idx];
 
     // Water-Bubble force calculations
     float bubbleVolume = 3.1415 * b.radius * b.radius;
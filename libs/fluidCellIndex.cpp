@@ -0,0 +1,76 @@
+#include <fluidCellIndex.h>
+#include <ordinalGrid.h>
+#include <state.h>
+
+constexpr int FluidCellIndex::NOT_FLUID;
+
+FluidCellIndex::FluidCellIndex(){
+  w = h = d = 0;
+}
+
+void FluidCellIndex::build(State const* const state){
+  build(state->getCellTypeGrid());
+}
+
+/**
+ * Count the fluid cells of every row in parallel, then number them from the
+ * running total of the rows before.
+ */
+void FluidCellIndex::build(Grid<CellType> const* const cellTypeGrid){
+  w = cellTypeGrid->getW();
+  h = cellTypeGrid->getH();
+  d = cellTypeGrid->getD();
+  indices.resize(w*h*d);
+
+  const int rows = h*d;
+  std::vector<unsigned int> rowStart(rows + 1, 0);
+  #pragma omp parallel for
+  for (int row = 0; row < rows; row++) {
+    unsigned int count = 0;
+    for (unsigned int i = 0; i < w; i++) {
+      count += cellTypeGrid->get(i, row % h, row / h) == CellType::FLUID ? 1 : 0;
+    }
+    rowStart[row + 1] = count;
+  }
+  for (int row = 0; row < rows; row++) {
+    rowStart[row + 1] += rowStart[row];
+  }
+
+  cells.resize(rowStart[rows]);
+  #pragma omp parallel for
+  for (int row = 0; row < rows; row++) {
+    const unsigned int j = row % h;
+    const unsigned int k = row / h;
+    unsigned int next = rowStart[row];
+    for (unsigned int i = 0; i < w; i++) {
+      if (cellTypeGrid->get(i, j, k) == CellType::FLUID) {
+        cells[next] = GridCoordinate(i, j, k);
+        indices[row*w + i] = next++;
+      } else {
+        indices[row*w + i] = NOT_FLUID;
+      }
+    }
+  }
+}
+
+unsigned int FluidCellIndex::size() const{
+  return cells.size();
+}
+
+int FluidCellIndex::get(int i, int j, int k) const{
+  if (i < 0 || j < 0 || k < 0 || i >= int(w) || j >= int(h) || k >= int(d)) {
+    return NOT_FLUID;
+  }
+  return indices[(k*h + j)*w + i];
+}
+
+GridCoordinate FluidCellIndex::getCell(unsigned int index) const{
+  return cells[index];
+}
+
+void FluidCellIndex::scatter(const std::vector<double> &values, OrdinalGrid<double> *grid) const{
+  grid->setForEach([&](unsigned int i, unsigned int j, unsigned int k){
+      const int index = indices[(k*h + j)*w + i];
+      return index == NOT_FLUID ? 0.0 : values[index];
+    });
+}
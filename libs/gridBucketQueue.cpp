@@ -0,0 +1,87 @@
+#include <gridBucketQueue.h>
+#include <algorithm>
+
+constexpr float GridBucketQueue::BUCKET_WIDTH;
+
+GridBucketQueue::GridBucketQueue(unsigned int w, unsigned int h, unsigned int d, OrdinalGrid<float> *cg) {
+  this->w = w;
+  this->h = h;
+  this->d = d;
+
+  // no distance in the grid is longer than its diagonal
+  const float diagonal = glm::length(glm::vec3(w, h, d));
+  buckets.resize((unsigned int)(diagonal/BUCKET_WIDTH) + 2);
+  first = buckets.size();
+  last = 0;
+
+  comparisonGrid = cg;
+}
+
+void GridBucketQueue::insert(GridCoordinate coord) {
+  const float key = glm::abs(comparisonGrid->get(coord));
+  // clamp before the cast, infinite and undefined keys go into the last bucket
+  const unsigned int lastBucket = buckets.size() - 1;
+  const float scaled = key/BUCKET_WIDTH;
+  const unsigned int bucket = scaled < lastBucket ? (unsigned int)scaled : lastBucket;
+  const uint32_t index = ((uint32_t)coord.z*h + coord.y)*w + coord.x;
+
+  buckets[bucket].push_back({index, key});
+  first = std::min(first, bucket);
+  last = std::max(last, bucket);
+}
+
+GridCoordinate GridBucketQueue::pop() {
+  findFirst();
+  const Entry entry = buckets[first].back();
+  buckets[first].pop_back();
+  return toCoordinate(entry.index);
+}
+
+bool GridBucketQueue::empty() {
+  return !findFirst();
+}
+
+/**
+ * Move first to the bucket holding the closest cell, dropping stale entries on the way.
+ */
+bool GridBucketQueue::findFirst() {
+  for (; first <= last; first++) {
+    std::vector<Entry> &bucket = buckets[first];
+    while (!bucket.empty() && isStale(bucket.back())) {
+      bucket.pop_back();
+    }
+    if (!bucket.empty()) {
+      return true;
+    }
+  }
+  first = buckets.size();
+  last = 0;
+  return false;
+}
+
+/**
+ * Distances only decrease while marching, so an entry whose key no longer
+ * matches its cell was replaced by a closer one.
+ */
+bool GridBucketQueue::isStale(const Entry &entry) const {
+  return glm::abs(comparisonGrid->get(toCoordinate(entry.index))) != entry.key;
+}
+
+GridCoordinate GridBucketQueue::toCoordinate(uint32_t index) const {
+  return GridCoordinate(index % w, (index/w) % h, index/(w*h));
+}
+
+/**
+ * Empty the queue, keeping the memory of the buckets for the next march.
+ */
+void GridBucketQueue::clear() {
+  for (unsigned int b = first; b <= last; b++) {
+    buckets[b].clear();
+  }
+  first = buckets.size();
+  last = 0;
+}
+
+void GridBucketQueue::setComparisonGrid(OrdinalGrid<float> *cg) {
+  comparisonGrid = cg;
+}
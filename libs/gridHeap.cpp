@@ -16,7 +16,7 @@ GridHeap::GridHeap(unsigned int w, unsigned int h, unsigned int d,  OrdinalGrid<
 }
 
 GridHeap::~GridHeap() {
-  delete coordinates;
+  delete[] coordinates;
   delete heapIndices;
 }
 
@@ -106,14 +106,28 @@ void GridHeap::percolateDown(int parent) {
   }
 }
 
+/**
+ * Orders by distance from the interface, on both sides of it.
+ */
 bool GridHeap::comp(GridCoordinate &a, GridCoordinate &b) {
-  return (comparisonGrid->get(a) < comparisonGrid->get(b));
+  return glm::abs(comparisonGrid->get(a)) < glm::abs(comparisonGrid->get(b));
 }
 
 bool GridHeap::empty() {
   return size == 0;
 }
 
+/**
+ * Empty the heap. Marching can stop before the heap runs empty,
+ * so the cells still in it are marked as not in the heap.
+ */
 void GridHeap::clear() {
+  for (unsigned int n = 0; n < size; n++) {
+    heapIndices->set(coordinates[n], NOT_IN_HEAP);
+  }
   size = 0;
 }
+
+void GridHeap::setComparisonGrid(OrdinalGrid<float> *cg) {
+  comparisonGrid = cg;
+}
@@ -1,6 +1,7 @@
 #include <jacobiIteration.h>
 #include <ordinalGrid.h>
 #include <state.h>
+#include <solidFaces.h>
 #include <algorithm>
 JacobiIteration::JacobiIteration(int maxIterations){
   this->maxIterations = maxIterations;
@@ -9,6 +10,7 @@ JacobiIteration::JacobiIteration(int maxIterations){
 bool JacobiIteration::solve(OrdinalGrid<float> const* const divergenceGrid, State const* const state, OrdinalGrid<double> *pressureGridTo, const float dt){
   const float sqDeltaX = 1.0f;
   Grid<CellType> const *const cellTypeGrid = state->getCellTypeGrid();
+  SolidFaces const *const solidFaces = state->getSolidFaces();
   const unsigned int w = state->getW();
   const unsigned int h = state->getH();
   const unsigned int d = state->getD();
@@ -31,53 +33,43 @@ bool JacobiIteration::solve(OrdinalGrid<float> const* const divergenceGrid, Stat
             continue;
           }
 
+          // neighbours outside the domain and behind solid faces are left out
+          const uint8_t mask = solidFaces->get(i, j, k);
+
           double pL = 0;
-          if(cellTypeGrid->isValid(i-1,j,k)){
-            if (cellTypeGrid->get(i - 1, j, k) != CellType::SOLID) {
-              pL = pressureGridFrom->get(i - 1, j, k);
-              neighbouringFluidCells++;
-            }
+          if (i > 0 && !(mask & SolidFaces::LEFT)) {
+            pL = pressureGridFrom->get(i - 1, j, k);
+            neighbouringFluidCells++;
           }
 
           double pR = 0;
-          if(cellTypeGrid->isValid(i + 1, j, k)){
-            if (cellTypeGrid->get(i + 1, j, k) != CellType::SOLID) {
-              pR = pressureGridFrom->get(i + 1, j, k);
-              neighbouringFluidCells++;
-            }
+          if (i + 1 < w && !(mask & SolidFaces::RIGHT)) {
+            pR = pressureGridFrom->get(i + 1, j, k);
+            neighbouringFluidCells++;
           }
 
           double pU = 0;
-          if(cellTypeGrid->isValid(i,j-1, k)){
-            if (cellTypeGrid->get(i, j - 1, k) != CellType::SOLID) {
-              pU = pressureGridFrom->get(i, j - 1, k);
-              neighbouringFluidCells++;
-            }
-
+          if (j > 0 && !(mask & SolidFaces::UP)) {
+            pU = pressureGridFrom->get(i, j - 1, k);
+            neighbouringFluidCells++;
           }
 
           double pD = 0;
-          if(cellTypeGrid->isValid(i,j+1, k)){
-            if (cellTypeGrid->get(i, j + 1, k) != CellType::SOLID) {
-              pD = pressureGridFrom->get(i, j + 1, k);
-              neighbouringFluidCells++;
-            }
+          if (j + 1 < h && !(mask & SolidFaces::DOWN)) {
+            pD = pressureGridFrom->get(i, j + 1, k);
+            neighbouringFluidCells++;
           }
 
           double pF = 0;
-          if(cellTypeGrid->isValid(i,j, k-1)){
-            if (cellTypeGrid->get(i, j, k - 1) != CellType::SOLID) {
-              pU = pressureGridFrom->get(i, j, k - 1);
-              neighbouringFluidCells++;
-            }
+          if (k > 0 && !(mask & SolidFaces::FRONT)) {
+            pF = pressureGridFrom->get(i, j, k - 1);
+            neighbouringFluidCells++;
           }
 
           double pB = 0;
-          if(cellTypeGrid->isValid(i,j, k+1)){
-            if (cellTypeGrid->get(i, j, k+1) != CellType::SOLID) {
-              pD = pressureGridFrom->get(i, j, k+1);
-              neighbouringFluidCells++;
-            }
+          if (k + 1 < d && !(mask & SolidFaces::BACK)) {
+            pB = pressureGridFrom->get(i, j, k + 1);
+            neighbouringFluidCells++;
           }
 
           divergence = divergenceGrid->get(i, j, k);
@@ -1,21 +1,43 @@
 #include <levelSet.h>
 #include <glm/ext.hpp>
-#include <gridHeap.h>
+#include <gridBucketQueue.h>
 #include <iostream>
+#include <algorithm>
+#include <cmath>
+
+namespace {
+  /**
+   * Fluid cells of the rows reduced so far, and their bounding box.
+   */
+  struct FluidCount {
+    unsigned int cells;
+    GridCoordinate lower, upper;
+  };
+}
+
+constexpr unsigned int LevelSet::TILE_SIZE;
+constexpr float LevelSet::DRIFT_TOLERANCE;
 
 LevelSet::LevelSet(unsigned int w, unsigned int h, unsigned int d, SignedDistanceFunction sdf, Grid<CellType> const* const ctg){
   this->w = w;
   this->h = h;
   this->d = d;
 
-  doneGrid = new Grid<bool>(w, h, d);
-  distanceGrid = new OrdinalGrid<float>(w, h, d);
-  oldDistanceGrid = new OrdinalGrid<float>(w, h, d);
+  doneGrid = new Grid<bool>(w, h, d, levelSetLayout());
+  distanceGrid = new OrdinalGrid<float>(w, h, d, levelSetLayout());
+  oldDistanceGrid = new OrdinalGrid<float>(w, h, d, levelSetLayout());
   cellTypeGrid = new Grid<CellType>(w, h, d);
   initSDF = new SignedDistanceFunction(sdf.getFunction());
   
-  gridHeap = new GridHeap(w, h, d, distanceGrid);
-  closestPointGrid = new Grid<glm::vec3>(w, h, d);
+  marchQueue = new GridBucketQueue(w, h, d, distanceGrid);
+  closestPointGrid = new Grid<glm::vec3>(w, h, d, levelSetLayout());
+  reinitializationMethod = ReinitializationMethod::FAST_MARCHING;
+  bandWidth = INF;
+  incremental = false;
+  reinitializedDistanceGrid = nullptr;
+  tilesW = tilesH = tilesD = 0;
+  marchingRegion = false;
+  sweepConverged = true;
 
   setCellTypeGrid(ctg);
   initializeDistanceGrid(sdf);
@@ -29,14 +51,21 @@ LevelSet::LevelSet(unsigned int w, unsigned int h, unsigned int d, SignedDistFun
   this->h = h;
   this->d = d;
 
-  doneGrid = new Grid<bool>(w, h, d);
-  distanceGrid = new OrdinalGrid<float>(w, h, d);
-  oldDistanceGrid = new OrdinalGrid<float>(w, h, d);
+  doneGrid = new Grid<bool>(w, h, d, levelSetLayout());
+  distanceGrid = new OrdinalGrid<float>(w, h, d, levelSetLayout());
+  oldDistanceGrid = new OrdinalGrid<float>(w, h, d, levelSetLayout());
   cellTypeGrid = new Grid<CellType>(w, h, d);
   initSDF = new SignedDistanceFunction(sdf);
 
-  gridHeap = new GridHeap(w,h,d, distanceGrid);
-  closestPointGrid = new Grid<glm::vec3>(w, h, d);
+  marchQueue = new GridBucketQueue(w, h, d, distanceGrid);
+  closestPointGrid = new Grid<glm::vec3>(w, h, d, levelSetLayout());
+  reinitializationMethod = ReinitializationMethod::FAST_MARCHING;
+  bandWidth = INF;
+  incremental = false;
+  reinitializedDistanceGrid = nullptr;
+  tilesW = tilesH = tilesD = 0;
+  marchingRegion = false;
+  sweepConverged = true;
 
   cellTypeGrid->setForEach(ctg);
   initializeDistanceGrid(*initSDF);
@@ -50,18 +79,28 @@ LevelSet::LevelSet(const LevelSet& origin) {
   h = origin.h;
   d = origin.d;
 
-  doneGrid = new Grid<bool>(w, h, d);
+  GridLayout layout = origin.distanceGrid->getLayout();
+  doneGrid = new Grid<bool>(w, h, d, layout);
   cellTypeGrid = new Grid<CellType>(*origin.cellTypeGrid);
   initSDF = new SignedDistanceFunction(origin.initSDF->getFunction());
 
   distanceGrid = new OrdinalGrid<float>(*origin.distanceGrid);
-  oldDistanceGrid = new OrdinalGrid<float>(w, h, d);
-
-  gridHeap = new GridHeap(w,h,d, distanceGrid);
-  closestPointGrid = new Grid<glm::vec3>(w, h, d);
+  oldDistanceGrid = new OrdinalGrid<float>(w, h, d, layout);
+
+  marchQueue = new GridBucketQueue(w, h, d, distanceGrid);
+  closestPointGrid = new Grid<glm::vec3>(w, h, d, layout);
+  reinitializationMethod = origin.reinitializationMethod;
+  bandWidth = origin.bandWidth;
+  incremental = origin.incremental;
+  reinitializedDistanceGrid = nullptr;
+  tilesW = tilesH = tilesD = 0;
+  marchingRegion = false;
+  sweepConverged = true;
 
   targetVolume = origin.targetVolume;
   currentVolume = origin.currentVolume;
+  fluidLower = origin.fluidLower;
+  fluidUpper = origin.fluidUpper;
 }
 
 
@@ -70,7 +109,8 @@ LevelSet::~LevelSet() {
   delete distanceGrid;
   delete cellTypeGrid;
   delete initSDF;
-  delete gridHeap;
+  delete marchQueue;
+  delete reinitializedDistanceGrid;
   delete closestPointGrid;
 }
 
@@ -115,22 +155,191 @@ void LevelSet::merge(LevelSet *other) {
 
 void LevelSet::reinitialize() {
   std::swap(oldDistanceGrid, distanceGrid);
-  gridHeap->clear();
-  updateInterfaceNeighbors();
-  fastMarch();
+  if (reinitializationMethod == ReinitializationMethod::FAST_SWEEPING) {
+    updateInterfaceCells();
+    fastSweep();
+  } else {
+    // the queue orders cells by the distances being built, not the old ones
+    marchQueue->setComparisonGrid(distanceGrid);
+    marchQueue->clear();
+    const bool regionOnly = incremental && bandWidth < INF && reinitializedDistanceGrid != nullptr;
+    if (regionOnly) {
+      markChangedTiles();
+      updateRegionInterfaceNeighbors();
+    } else {
+      updateInterfaceNeighbors();
+    }
+    fastMarch();
+    marchingRegion = false;
+    if (bandWidth < INF) {
+      fillOutsideBand();
+    }
+    updateCellTypes();
+    clampInfiniteCells();
+    if (incremental && bandWidth < INF) {
+      rememberReinitializedDistances(regionOnly);
+    }
+    closestPointGrid->prune();
+    return;
+  }
   updateCellTypes();
   clampInfiniteCells();
+  closestPointGrid->prune();
 }
 
-void LevelSet::updateInterfaceNeighbors(){
-  for(unsigned k = 0; k < d; ++k) {
-    for(unsigned j = 0; j < h; ++j) {
-      for(unsigned i = 0; i < w; ++i) {
-        updateInterfaceNeighborCell(i, j, k);
+void LevelSet::setReinitializationMethod(ReinitializationMethod method) {
+  reinitializationMethod = method;
+}
+
+ReinitializationMethod LevelSet::getReinitializationMethod() const {
+  return reinitializationMethod;
+}
+
+bool LevelSet::getSweepConverged() const {
+  return sweepConverged;
+}
+
+void LevelSet::setBandWidth(float bandWidth) {
+  this->bandWidth = bandWidth;
+}
+
+float LevelSet::getBandWidth() const {
+  return bandWidth;
+}
+
+void LevelSet::setIncrementalReinitialization(bool incremental) {
+  this->incremental = incremental;
+}
+
+bool LevelSet::getIncrementalReinitialization() const {
+  return incremental;
+}
+
+/**
+ * Mark the tiles with a cell that changed sign or drifted more than DRIFT_TOLERANCE
+ * from its reinitialized distance, and grow them by enough tiles to cover the band
+ * around their interface.
+ */
+void LevelSet::markChangedTiles() {
+  tilesW = (w + TILE_SIZE - 1)/TILE_SIZE;
+  tilesH = (h + TILE_SIZE - 1)/TILE_SIZE;
+  tilesD = (d + TILE_SIZE - 1)/TILE_SIZE;
+  const int tiles = tilesW*tilesH*tilesD;
+  std::vector<char> changed(tiles, 0);
+
+  #pragma omp parallel for schedule(dynamic)
+  for (int t = 0; t < tiles; t++) {
+    const unsigned int ti = t % tilesW;
+    const unsigned int tj = (t/tilesW) % tilesH;
+    const unsigned int tk = t/(tilesW*tilesH);
+    for (unsigned int k = tk*TILE_SIZE; k < std::min((tk + 1)*TILE_SIZE, (unsigned int)d) && !changed[t]; k++) {
+      for (unsigned int j = tj*TILE_SIZE; j < std::min((tj + 1)*TILE_SIZE, (unsigned int)h) && !changed[t]; j++) {
+        for (unsigned int i = ti*TILE_SIZE; i < std::min((ti + 1)*TILE_SIZE, (unsigned int)w); i++) {
+          // the distances being reinitialized were swapped into oldDistanceGrid
+          const float current = oldDistanceGrid->get(i, j, k);
+          const float reinitialized = reinitializedDistanceGrid->get(i, j, k);
+          if (sgn(current) != sgn(reinitialized) || glm::abs(current - reinitialized) > DRIFT_TOLERANCE) {
+            changed[t] = 1;
+            break;
+          }
+        }
       }
     }
   }
-  
+
+  const int halo = (int)std::ceil((bandWidth + 1.0f)/TILE_SIZE);
+  regionTiles.assign(tiles, 0);
+  for (int t = 0; t < tiles; t++) {
+    if (!changed[t]) {
+      continue;
+    }
+    const int ti = t % tilesW;
+    const int tj = (t/tilesW) % tilesH;
+    const int tk = t/(tilesW*tilesH);
+    for (int k = std::max(0, tk - halo); k <= std::min((int)tilesD - 1, tk + halo); k++) {
+      for (int j = std::max(0, tj - halo); j <= std::min((int)tilesH - 1, tj + halo); j++) {
+        for (int i = std::max(0, ti - halo); i <= std::min((int)tilesW - 1, ti + halo); i++) {
+          regionTiles[(k*tilesH + j)*tilesW + i] = 1;
+        }
+      }
+    }
+  }
+}
+
+bool LevelSet::inRegion(unsigned int i, unsigned int j, unsigned int k) const {
+  return regionTiles[((k/TILE_SIZE)*tilesH + j/TILE_SIZE)*tilesW + i/TILE_SIZE];
+}
+
+/**
+ * updateInterfaceNeighbors for the tiles in the region. Cells outside it keep their
+ * distance and closest point, and start the march into the region from its border.
+ */
+void LevelSet::updateRegionInterfaceNeighbors() {
+  distanceGrid->setForEach([&](unsigned int i, unsigned int j, unsigned int k) {
+      return inRegion(i, j, k) ? updateInterfaceNeighborCell(i, j, k) : oldDistanceGrid->get(i, j, k);
+    });
+
+  marchingRegion = true;
+  for (unsigned int t = 0; t < regionTiles.size(); t++) {
+    if (!regionTiles[t]) {
+      continue;
+    }
+    const unsigned int ti = t % tilesW;
+    const unsigned int tj = (t/tilesW) % tilesH;
+    const unsigned int tk = t/(tilesW*tilesH);
+    for (unsigned int k = tk*TILE_SIZE; k < std::min((tk + 1)*TILE_SIZE, (unsigned int)d); k++) {
+      for (unsigned int j = tj*TILE_SIZE; j < std::min((tj + 1)*TILE_SIZE, (unsigned int)h); j++) {
+        for (unsigned int i = ti*TILE_SIZE; i < std::min((ti + 1)*TILE_SIZE, (unsigned int)w); i++) {
+          const GridCoordinate c(i, j, k);
+          if (glm::abs(distanceGrid->get(c)) < INF) {
+            updateNeighborsFrom(c);
+          }
+
+          const GridCoordinate neighbors[] = {
+            GridCoordinate(i - 1, j, k), GridCoordinate(i + 1, j, k),
+            GridCoordinate(i, j - 1, k), GridCoordinate(i, j + 1, k),
+            GridCoordinate(i, j, k - 1), GridCoordinate(i, j, k + 1)
+          };
+          for (const GridCoordinate &neighbor : neighbors) {
+            if (neighbor.x < 0 || neighbor.y < 0 || neighbor.z < 0 ||
+                neighbor.x >= w || neighbor.y >= h || neighbor.z >= d ||
+                inRegion(neighbor.x, neighbor.y, neighbor.z)) {
+              continue;
+            }
+            if (glm::abs(distanceGrid->get(neighbor)) <= bandWidth &&
+                !isOutsideBand(closestPointGrid->get(neighbor))) {
+              updateFromCell(neighbor, c);
+            }
+          }
+        }
+      }
+    }
+  }
+}
+
+/**
+ * Keep the reinitialized distances to find the tiles that change until the next
+ * reinitialization.
+ */
+void LevelSet::rememberReinitializedDistances(bool regionOnly) {
+  if (reinitializedDistanceGrid == nullptr) {
+    reinitializedDistanceGrid = new OrdinalGrid<float>(w, h, d, distanceGrid->getLayout());
+  }
+  reinitializedDistanceGrid->setForEach([&](unsigned int i, unsigned int j, unsigned int k) {
+      return !regionOnly || inRegion(i, j, k) ? distanceGrid->get(i, j, k) : reinitializedDistanceGrid->get(i, j, k);
+    });
+}
+
+void LevelSet::updateInterfaceCells(){
+  // cells away from the interface get +-INF, which keeps sparse bricks unallocated
+  distanceGrid->setForEach([&](unsigned int i, unsigned int j, unsigned int k) {
+      return updateInterfaceNeighborCell(i, j, k);
+    });
+}
+
+void LevelSet::updateInterfaceNeighbors(){
+  updateInterfaceCells();
+
   for(unsigned k = 0; k < d; ++k) {
     for(unsigned j = 0; j < h; ++j) {
       for(unsigned i = 0; i < w; ++i) {
@@ -144,22 +353,19 @@ void LevelSet::updateInterfaceNeighbors(){
 
 
 void LevelSet::clampInfiniteCells() {
-  for(auto k = 0u; k < d; k++) {
-    for(auto j = 0u; j < h; j++) {
-      for(auto i = 0u; i < w; i++) {
-        if (distanceGrid->get(i, j, k) > 5.0) {
-          distanceGrid->set(i, j, k, 5.0);
-        }
-        if (distanceGrid->get(i, j, k) < -5.0) {
-          distanceGrid->set(i, j, k, -5.0);
-        }
-      }
-    }
-  }
+  // sparse bricks that are entirely clamped collapse to a single value
+  distanceGrid->setForEach([&](unsigned int i, unsigned int j, unsigned int k) {
+      return glm::clamp(distanceGrid->get(i, j, k), -5.0f, 5.0f);
+    });
 }
 
 
-void LevelSet::updateInterfaceNeighborCell(unsigned int i, unsigned int j, unsigned int k) {
+/**
+ * Distance from a cell to the interface, if the interface crosses one of its edges.
+ * Stores the closest point of interface cells.
+ * @return signed distance, or +-INF if no neighbor has a different sign
+ */
+float LevelSet::updateInterfaceNeighborCell(unsigned int i, unsigned int j, unsigned int k) {
   float current = oldDistanceGrid->get(i, j, k);
   float east = oldDistanceGrid->clampGet(i+1, j, k);
   float west = oldDistanceGrid->clampGet(i-1, j, k);
@@ -221,8 +427,7 @@ void LevelSet::updateInterfaceNeighborCell(unsigned int i, unsigned int j, unsig
     closestPointGrid->set(i, j, k, closestPoint);
   }
 
-  distanceGrid->set(i, j, k, dist*currentCellSign);
-  
+  return dist*currentCellSign;
 }
 
 void LevelSet::updateNeighborsFrom(GridCoordinate from) {
@@ -250,6 +455,10 @@ void LevelSet::updateFromCell(GridCoordinate from,
   unsigned int yTo = to.y;
   unsigned int zTo = to.z;
 
+  if (marchingRegion && !inRegion(xTo, yTo, zTo)) {
+    return;
+  }
+
   float d = distanceGrid->get(xTo, yTo, zTo);
   glm::vec3 pointCandidate = closestPointGrid->get(xFrom, yFrom, zFrom);
   float dCandidate = glm::distance(pointCandidate, glm::vec3(xTo, yTo, zTo));
@@ -257,17 +466,137 @@ void LevelSet::updateFromCell(GridCoordinate from,
   if (dCandidate < glm::abs(d)) {
     distanceGrid->set(xTo, yTo, zTo, dCandidate*sgn(d));
     closestPointGrid->set(xTo, yTo, zTo, pointCandidate);
-    gridHeap->insert(GridCoordinate(xTo, yTo, zTo));
+    marchQueue->insert(GridCoordinate(xTo, yTo, zTo));
   }
 }
 
+/**
+ * Cells leave the queue in order of distance, up to one bucket width. A cell
+ * can still improve its neighbours to one cell less than its own distance,
+ * so marching stops one cell and one bucket beyond the band.
+ */
 void LevelSet::fastMarch() {
-  while (!(gridHeap->empty())) {
-    GridCoordinate c = gridHeap->pop();
+  while (!(marchQueue->empty())) {
+    GridCoordinate c = marchQueue->pop();
+    if (glm::abs(distanceGrid->get(c)) > bandWidth + 1.0f + GridBucketQueue::BUCKET_WIDTH) {
+      break;
+    }
     updateNeighborsFrom(GridCoordinate(c.x, c.y, c.z));
   }
 }
 
+/**
+ * Give the cells beyond the band a background distance with the sign of their side
+ * and mark their closest points, so sparse bricks outside the band stay uniform.
+ */
+void LevelSet::fillOutsideBand() {
+  closestPointGrid->setForEach([&](unsigned int i, unsigned int j, unsigned int k) {
+      return glm::abs(distanceGrid->get(i, j, k)) > bandWidth ? outsideBand() : closestPointGrid->get(i, j, k);
+    });
+  distanceGrid->setForEach([&](unsigned int i, unsigned int j, unsigned int k) {
+      const float distance = distanceGrid->get(i, j, k);
+      return glm::abs(distance) > bandWidth ? bandWidth*sgn(distance) : distance;
+    });
+}
+
+
+/**
+ * Propagate the closest points of the interface cells with fast sweeping.
+ * A cell takes the closest point of a neighbour when that is nearer,
+ * the same update as fastMarch, so both give the same closest points up to
+ * ties. The sweeps work on flat copies of the fields, which are safe to write
+ * from several threads for every grid layout.
+ */
+void LevelSet::fastSweep() {
+  const int size = w*h*d;
+  sweepDistances.resize(size);
+  sweepPoints.resize(size);
+  #pragma omp parallel for collapse(2)
+  for (int k = 0; k < d; k++) {
+    for (int j = 0; j < h; j++) {
+      for (int i = 0; i < w; i++) {
+        const int index = (k*h + j)*w + i;
+        sweepDistances[index] = distanceGrid->get(i, j, k);
+        sweepPoints[index] = closestPointGrid->get(i, j, k);
+      }
+    }
+  }
+
+  // every round carries the distances around at least one more bend of the
+  // characteristics, and a path through the grid bends fewer times than it has cells
+  const unsigned int maxRounds = w + h + d;
+  sweepConverged = false;
+  for (unsigned int round = 0; round < maxRounds && !sweepConverged; round++) {
+    bool changed = false;
+    for (int sk = -1; sk <= 1; sk += 2) {
+      for (int sj = -1; sj <= 1; sj += 2) {
+        for (int si = -1; si <= 1; si += 2) {
+          changed = sweep(si, sj, sk) || changed;
+        }
+      }
+    }
+    sweepConverged = !changed;
+  }
+
+  distanceGrid->setForEach([&](unsigned int i, unsigned int j, unsigned int k) {
+      return sweepDistances[(k*h + j)*w + i];
+    });
+  // cells no sweep reached keep their old closest point, like after fastMarch
+  closestPointGrid->setForEach([&](unsigned int i, unsigned int j, unsigned int k) {
+      const int index = (k*h + j)*w + i;
+      return glm::abs(sweepDistances[index]) < INF ? sweepPoints[index] : closestPointGrid->get(i, j, k);
+    });
+}
+
+/**
+ * One Gauss-Seidel sweep in the direction (si, sj, sk), every component +-1.
+ * The neighbours of a cell lie on the previous and the next diagonal wavefront,
+ * so the cells of a wavefront are independent and updated in parallel.
+ * @return whether any cell changed
+ */
+bool LevelSet::sweep(int si, int sj, int sk) {
+  bool changed = false;
+  const int wavefronts = w + h + d - 2;
+  #pragma omp parallel reduction(||:changed)
+  for (int front = 0; front < wavefronts; front++) {
+    // lk, lj, li count along the sweep direction, lk + lj + li == front
+    #pragma omp for schedule(dynamic, 4)
+    for (int lk = std::max(0, front - (w - 1) - (h - 1)); lk <= std::min(d - 1, front); lk++) {
+      const int k = sk > 0 ? lk : d - 1 - lk;
+      for (int lj = std::max(0, front - lk - (w - 1)); lj <= std::min(h - 1, front - lk); lj++) {
+        const int j = sj > 0 ? lj : h - 1 - lj;
+        const int i = si > 0 ? front - lk - lj : w - 1 - (front - lk - lj);
+        const int index = (k*h + j)*w + i;
+        const glm::vec3 position(i, j, k);
+        float distance = glm::abs(sweepDistances[index]);
+        int from = -1;
+
+        const int neighbours[] = {
+          i > 0 ? index - 1 : -1, i + 1 < w ? index + 1 : -1,
+          j > 0 ? index - w : -1, j + 1 < h ? index + w : -1,
+          k > 0 ? index - w*h : -1, k + 1 < d ? index + w*h : -1
+        };
+        for (int neighbour : neighbours) {
+          if (neighbour < 0 || glm::abs(sweepDistances[neighbour]) >= INF) {
+            continue;
+          }
+          const float candidate = glm::distance(sweepPoints[neighbour], position);
+          if (candidate < distance) {
+            distance = candidate;
+            from = neighbour;
+          }
+        }
+
+        if (from >= 0) {
+          sweepDistances[index] = distance*sgn(sweepDistances[index]);
+          sweepPoints[index] = sweepPoints[from];
+          changed = true;
+        }
+      }
+    }
+  }
+  return changed;
+}
 
 float LevelSet::getVolumeError() {
   return targetVolume - currentVolume;
@@ -284,36 +613,48 @@ void LevelSet::initializeDistanceGrid(SignedDistanceFunction sdf) {
   });
 }
 
+/**
+ * Classify the cells a row at a time from their contiguous distances, counting
+ * the fluid cells and the box around them in the same pass. Dense distance rows
+ * are read in place, other layouts are copied to a buffer kept per thread.
+ */
 void LevelSet::updateCellTypes() {
-  cellTypeGrid->setForEach([&](unsigned int i, unsigned int j, unsigned int k){
-    if(cellTypeGrid->get(i, j, k) != CellType::SOLID ) {
-      if(distanceGrid->get(i, j, k) > 0) {
-        return CellType::EMPTY;
+  const FluidCount none = {0u, GridCoordinate(w, h, d), GridCoordinate(-1, -1, -1)};
+  const FluidCount fluid = cellTypeGrid->setForEachRowReduce(none,
+    [&](unsigned int j, unsigned int k, CellType *types) {
+      static thread_local std::vector<float> buffer;
+      if ((int)buffer.size() < w) {
+        buffer.resize(w);
       }
-      return CellType::FLUID;
-    } else {
-      return CellType::SOLID;
-    }
-  });
-
-  // cell type update done - update current volume
-  updateCurrentVolume();
-}
-
-void LevelSet::updateCurrentVolume() {
-  unsigned int totalFluidCells = 0;
-
-  for(unsigned k = 0; k < d; ++k) {
-    for(unsigned j = 0; j < h; ++j) {
-      for(unsigned i = 0; i < w; ++i) {
-        if(cellTypeGrid->get(i, j, k) == CellType::FLUID) {
-          ++totalFluidCells; 
-        }
+      const float *distances = distanceGrid->readRow(j, k, buffer.data());
+      unsigned int cells = 0;
+      for (int i = 0; i < w; i++) {
+        const CellType type = distances[i] > 0 ? CellType::EMPTY : CellType::FLUID;
+        types[i] = types[i] == CellType::SOLID ? CellType::SOLID : type;
+        cells += types[i] == CellType::FLUID;
       }
-    }
-  }
+      if (cells == 0) {
+        return none;
+      }
+      int first = 0;
+      int last = w - 1;
+      while (types[first] != CellType::FLUID) first++;
+      while (types[last] != CellType::FLUID) last--;
+      return FluidCount{cells, GridCoordinate(first, j, k), GridCoordinate(last, j, k)};
+    },
+    [](const FluidCount &a, const FluidCount &b) {
+      return FluidCount{a.cells + b.cells, glm::min(a.lower, b.lower), glm::max(a.upper, b.upper)};
+    });
+
+  currentVolume = (float)fluid.cells / (float)(w*h);
+  fluidLower = fluid.lower;
+  fluidUpper = fluid.upper;
+}
 
-  currentVolume = (float)totalFluidCells / (float)(w*h);
+bool LevelSet::getFluidBounds(GridCoordinate &lower, GridCoordinate &upper) const {
+  lower = fluidLower;
+  upper = fluidUpper;
+  return fluidLower.x <= fluidUpper.x;
 }
 
 void LevelSet::setCellTypeGrid(Grid<CellType> const* const ctg) {
@@ -350,7 +691,7 @@ int LevelSet::sgn(const float &val) {
 
 std::ostream& LevelSet::write(std::ostream& stream){
   distanceGrid->write(stream);
-  cellTypeGrid->write(stream);
+  writeCellTypes(stream);
   stream.write(reinterpret_cast<char*>(&w), sizeof(w));
   stream.write(reinterpret_cast<char*>(&h), sizeof(h));
   stream.write(reinterpret_cast<char*>(&d), sizeof(d));
@@ -361,7 +702,7 @@ std::ostream& LevelSet::write(std::ostream& stream){
 
 std::istream& LevelSet::read(std::istream& stream){
   distanceGrid->read(stream);
-  cellTypeGrid->read(stream);
+  readCellTypes(stream);
   stream.read(reinterpret_cast<char*>(&w), sizeof(w));
   stream.read(reinterpret_cast<char*>(&h), sizeof(h));
   stream.read(reinterpret_cast<char*>(&d), sizeof(d));
@@ -371,3 +712,39 @@ std::istream& LevelSet::read(std::istream& stream){
   reinitialize();
   return stream;
 }
+
+/**
+ * Cell types are stored as int32_t, as they were before CellType shrank to one byte,
+ * so that older files stay readable.
+ */
+void LevelSet::writeCellTypes(std::ostream& stream){
+  unsigned int gw = cellTypeGrid->getW(), gh = cellTypeGrid->getH(), gd = cellTypeGrid->getD();
+  stream.write(reinterpret_cast<char*>(&gw), sizeof(gw));
+  stream.write(reinterpret_cast<char*>(&gh), sizeof(gh));
+  stream.write(reinterpret_cast<char*>(&gd), sizeof(gd));
+  std::vector<int32_t> types(gw*gh*gd);
+  for(auto k = 0u; k < gd; k++){
+    for(auto j = 0u; j < gh; j++){
+      for(auto i = 0u; i < gw; i++){
+        types[(k*gh + j)*gw + i] = cellTypeGrid->get(i, j, k);
+      }
+    }
+  }
+  stream.write(reinterpret_cast<char*>(types.data()), sizeof(int32_t)*types.size());
+}
+
+void LevelSet::readCellTypes(std::istream& stream){
+  unsigned int gw, gh, gd;
+  stream.read(reinterpret_cast<char*>(&gw), sizeof(gw));
+  stream.read(reinterpret_cast<char*>(&gh), sizeof(gh));
+  stream.read(reinterpret_cast<char*>(&gd), sizeof(gd));
+  std::vector<int32_t> types(gw*gh*gd);
+  stream.read(reinterpret_cast<char*>(types.data()), sizeof(int32_t)*types.size());
+  for(auto k = 0u; k < gd; k++){
+    for(auto j = 0u; j < gh; j++){
+      for(auto i = 0u; i < gw; i++){
+        cellTypeGrid->set(i, j, k, (CellType)types[(k*gh + j)*gw + i]);
+      }
+    }
+  }
+}
@@ -0,0 +1,170 @@
+#include <micPreconditioner.h>
+#include <pressureStencil.h>
+#include <algorithm>
+#include <cmath>
+
+constexpr double MICPreconditioner::MIC_TUNING;
+constexpr double MICPreconditioner::MIC_SAFETY;
+
+MICPreconditioner::MICPreconditioner(bool levelScheduled){
+  this->levelScheduled = levelScheduled;
+  stencil = nullptr;
+}
+
+void MICPreconditioner::build(State const* const, PressureStencil const* const stencil){
+  this->stencil = stencil;
+  const int size = stencil->size();
+  precon.resize(size);
+
+  if (!levelScheduled) {
+    for (int n = 0; n < size; n++) {
+      factor(n);
+    }
+    return;
+  }
+
+  buildLevels();
+  const int levels = levelStart.size() - 1;
+  #pragma omp parallel
+  for (int l = 0; l < levels; l++) {
+    #pragma omp for
+    for (int c = levelStart[l]; c < levelStart[l + 1]; c++) {
+      factor(levelCells[c]);
+    }
+  }
+}
+
+/**
+ * Solve L L^T z = r, with the forward substitution written to z
+ * and the backward substitution done in place.
+ */
+void MICPreconditioner::apply(const std::vector<double> &r, std::vector<double> &z){
+  const int size = stencil->size();
+
+  if (!levelScheduled) {
+    for (int n = 0; n < size; n++) {
+      forward(n, r, z);
+    }
+    for (int n = size - 1; n >= 0; n--) {
+      backward(n, z);
+    }
+    return;
+  }
+
+  const int levels = levelStart.size() - 1;
+  #pragma omp parallel
+  {
+    for (int l = 0; l < levels; l++) {
+      #pragma omp for
+      for (int c = levelStart[l]; c < levelStart[l + 1]; c++) {
+        forward(levelCells[c], r, z);
+      }
+    }
+    for (int l = levels - 1; l >= 0; l--) {
+      #pragma omp for
+      for (int c = levelStart[l]; c < levelStart[l + 1]; c++) {
+        backward(levelCells[c], z);
+      }
+    }
+  }
+}
+
+/**
+ * Counting sort of the fluid cells by i + j + k, keeping the flat order within a level.
+ */
+void MICPreconditioner::buildLevels(){
+  const int size = stencil->size();
+  int levels = 0;
+  for (int n = 0; n < size; n++) {
+    const GridCoordinate c = stencil->fluidCells.getCell(n);
+    levels = std::max(levels, c.x + c.y + c.z + 1);
+  }
+
+  levelStart.assign(levels + 1, 0);
+  for (int n = 0; n < size; n++) {
+    const GridCoordinate c = stencil->fluidCells.getCell(n);
+    levelStart[c.x + c.y + c.z + 1]++;
+  }
+  for (int l = 0; l < levels; l++) {
+    levelStart[l + 1] += levelStart[l];
+  }
+
+  std::vector<int> next(levelStart.begin(), levelStart.end() - 1);
+  levelCells.resize(size);
+  for (int n = 0; n < size; n++) {
+    const GridCoordinate c = stencil->fluidCells.getCell(n);
+    levelCells[next[c.x + c.y + c.z]++] = n;
+  }
+}
+
+/**
+ * Every cell depends on its -x, -y and -z neighbours, which come before it
+ * in the numbering.
+ */
+void MICPreconditioner::factor(int n){
+  const std::vector<double> &plusI = stencil->plusI;
+  const std::vector<double> &plusJ = stencil->plusJ;
+  const std::vector<double> &plusK = stencil->plusK;
+  const double diag = stencil->diag[n];
+  if (diag == 0.0) {
+    // a fluid cell walled in by solids has no pressure to solve for
+    precon[n] = 0.0;
+    return;
+  }
+
+  double e = diag;
+  int m = stencil->previousI[n];
+  if (m != FluidCellIndex::NOT_FLUID) {
+    const double a = plusI[m]*precon[m];
+    e -= a*a + MIC_TUNING*plusI[m]*(plusJ[m] + plusK[m])*precon[m]*precon[m];
+  }
+  m = stencil->previousJ[n];
+  if (m != FluidCellIndex::NOT_FLUID) {
+    const double a = plusJ[m]*precon[m];
+    e -= a*a + MIC_TUNING*plusJ[m]*(plusI[m] + plusK[m])*precon[m]*precon[m];
+  }
+  m = stencil->previousK[n];
+  if (m != FluidCellIndex::NOT_FLUID) {
+    const double a = plusK[m]*precon[m];
+    e -= a*a + MIC_TUNING*plusK[m]*(plusI[m] + plusJ[m])*precon[m]*precon[m];
+  }
+
+  if (e < MIC_SAFETY*diag) {
+    e = diag;
+  }
+  precon[n] = 1.0/std::sqrt(e);
+}
+
+void MICPreconditioner::forward(int n, const std::vector<double> &r, std::vector<double> &z) const{
+  double t = r[n];
+  int m = stencil->previousI[n];
+  if (m != FluidCellIndex::NOT_FLUID) {
+    t -= stencil->plusI[m]*precon[m]*z[m];
+  }
+  m = stencil->previousJ[n];
+  if (m != FluidCellIndex::NOT_FLUID) {
+    t -= stencil->plusJ[m]*precon[m]*z[m];
+  }
+  m = stencil->previousK[n];
+  if (m != FluidCellIndex::NOT_FLUID) {
+    t -= stencil->plusK[m]*precon[m]*z[m];
+  }
+  z[n] = t*precon[n];
+}
+
+void MICPreconditioner::backward(int n, std::vector<double> &z) const{
+  double t = z[n];
+  int m = stencil->nextI[n];
+  if (m != FluidCellIndex::NOT_FLUID) {
+    t -= stencil->plusI[n]*precon[n]*z[m];
+  }
+  m = stencil->nextJ[n];
+  if (m != FluidCellIndex::NOT_FLUID) {
+    t -= stencil->plusJ[n]*precon[n]*z[m];
+  }
+  m = stencil->nextK[n];
+  if (m != FluidCellIndex::NOT_FLUID) {
+    t -= stencil->plusK[n]*precon[n]*z[m];
+  }
+  z[n] = t*precon[n];
+}
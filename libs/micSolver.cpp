@@ -1,6 +1,7 @@
 #include <micSolver.h>
 #include <ordinalGrid.h>
 #include <state.h>
+#include <solidFaces.h>
 
 MICSolver::MICSolver(int size){
   solver = PCGSolver<double>();
@@ -24,129 +25,52 @@ bool MICSolver::solve(OrdinalGrid<float> const* const divergenceGrid, State cons
               <<  residual << " as a residual" <<  std::endl;
     solved = false;
   }
-  pressureGrid->setForEach([&](unsigned int i, unsigned int j, unsigned int k){
-      return xVector->at(pressureGrid->indexTranslation(i,j,k));
-    });
+  fluidCells.scatter(*xVector, pressureGrid);
   return solved;
 }
+/**
+ * Assemble the pressure matrix over the fluid cells only, numbered by fluidCells.
+ */
 void MICSolver::fillA(SparseMatrix<double> *aMatrix, State const* const state, const float dt){
+  SolidFaces const *const solidFaces = state->getSolidFaces();
+  fluidCells.build(state);
+  const unsigned int size = fluidCells.size();
+  aMatrix->resize(size);
   aMatrix->zero();
-  int w = state->getCellTypeGrid()->getW();
-  int h = state->getCellTypeGrid()->getH();
-  int d = state->getCellTypeGrid()->getD();
-  unsigned int row = 0;
+  xVector->resize(size);
+  bVector->resize(size);
 
-  for(auto k = 0u; k < d; k++){
-    for(auto j = 0u; j < h; j++){
-      for(auto i = 0u; i < w; i++){
+  const double scale = dt;
+  const uint8_t faces[] = {
+    SolidFaces::LEFT, SolidFaces::RIGHT, SolidFaces::UP, SolidFaces::DOWN, SolidFaces::FRONT, SolidFaces::BACK
+  };
+  for(auto row = 0u; row < size; row++){
+    const GridCoordinate c = fluidCells.getCell(row);
+    const GridCoordinate neighbours[] = {
+      GridCoordinate(c.x - 1, c.y, c.z), GridCoordinate(c.x + 1, c.y, c.z),
+      GridCoordinate(c.x, c.y - 1, c.z), GridCoordinate(c.x, c.y + 1, c.z),
+      GridCoordinate(c.x, c.y, c.z - 1), GridCoordinate(c.x, c.y, c.z + 1)
+    };
+    const uint8_t mask = solidFaces->get(c.x, c.y, c.z);
 
-        CellType ct0 = state->getCellTypeGrid()->get(i,j,k);
-        double scale = dt;
-
-        if(ct0 == CellType::FLUID){
-          auto indexTranslation = [&](unsigned int i, unsigned int j, unsigned int k){
-            return state->getCellTypeGrid()->indexTranslation(i, j, k);
-          };
-
-          // left
-          if(state->getCellTypeGrid()->isValid(i-1,j,k)){
-            CellType ct = state->getCellTypeGrid()->get(i-1,j,k);
-            if(ct == CellType::FLUID){
-              aMatrix->add_to_element(row, row, scale);
-              aMatrix->set_element(row, indexTranslation(i-1,j,k), -scale);
-            }
-            else if(ct == CellType::EMPTY){
-              aMatrix->add_to_element(row, row, scale);
-            }
-          } else {
-            aMatrix->add_to_element(row, row, scale);
-          }
-
-          // right
-          if(state->getCellTypeGrid()->isValid(i+1,j,k)){
-            CellType ct = state->getCellTypeGrid()->get(i+1,j,k);
-            if(ct == CellType::FLUID){
-              aMatrix->add_to_element(row, row, scale);
-              aMatrix->set_element(row, indexTranslation(i+1,j,k), -scale);
-            }
-            else if(ct == CellType::EMPTY){
-              aMatrix->add_to_element(row, row, scale);
-            }
-          } else {
-            aMatrix->add_to_element(row, row, scale);
-          }
-
-          // up
-          if(state->getCellTypeGrid()->isValid(i,j-1,k)){
-            CellType ct = state->getCellTypeGrid()->get(i,j-1,k);
-            if(ct == CellType::FLUID){
-              aMatrix->add_to_element(row, row, scale);
-              aMatrix->set_element(row, indexTranslation(i,j-1,k), -scale);
-            }
-            else if(ct == CellType::EMPTY){
-              aMatrix->add_to_element(row, row, scale);
-            }
-          } else {
-            aMatrix->add_to_element(row, row, scale);
-          }
-
-          // down
-          if(state->getCellTypeGrid()->isValid(i,j+1,k)){
-            CellType ct = state->getCellTypeGrid()->get(i,j+1,k);
-            if(ct == CellType::FLUID){
-              aMatrix->add_to_element(row, row, scale);
-              aMatrix->set_element(row, indexTranslation(i,j+1,k), -scale);
-            }
-            else if(ct == CellType::EMPTY){
-              aMatrix->add_to_element(row, row, scale);
-            }
-          } else {
-            aMatrix->add_to_element(row, row, scale);
-          }
-
-          // front
-          if(state->getCellTypeGrid()->isValid(i,j,k-1)){
-            CellType ct = state->getCellTypeGrid()->get(i,j,k-1);
-            if(ct == CellType::FLUID){
-              aMatrix->add_to_element(row, row, scale);
-              aMatrix->set_element(row, indexTranslation(i,j,k-1), -scale);
-            }
-            else if(ct == CellType::EMPTY){
-              aMatrix->add_to_element(row, row, scale);
-            }
-          } else {
-            aMatrix->add_to_element(row, row, scale);
-          }
-
-          // back
-          if(state->getCellTypeGrid()->isValid(i,j,k+1)){
-            CellType ct = state->getCellTypeGrid()->get(i,j,k+1);
-            if(ct == CellType::FLUID){
-              aMatrix->add_to_element(row, row, scale);
-              aMatrix->set_element(row, indexTranslation(i,j,k+1), -scale);
-            }
-            else if(ct == CellType::EMPTY){
-              aMatrix->add_to_element(row, row, scale);
-            }
-          } else {
-            aMatrix->add_to_element(row, row, scale);
-          }
-
-        }
-        row++;
+    // air and the domain boundary only add to the diagonal, solids are left out
+    for (int f = 0; f < 6; f++) {
+      if (mask & faces[f]) {
+        continue;
+      }
+      aMatrix->add_to_element(row, row, scale);
+      const int column = fluidCells.get(neighbours[f].x, neighbours[f].y, neighbours[f].z);
+      if (column != FluidCellIndex::NOT_FLUID) {
+        aMatrix->set_element(row, column, -scale);
       }
     }
-    // for (int j = 0; j < w*h; ++j){
-    //  for (int i = 0; i < w*h; ++i){
-    //          std::cout << (*aMatrix)(i,j);
-    //  }
-    //  std::cout << std::endl;
-    // }
   }
 }
 
 void MICSolver::fillB(std::vector<double> *bVector, OrdinalGrid<float> const* const divergenceGrid){
-  for(auto i = 0u; i < divergenceGrid->size(); i++){
-    bVector->at(i) = divergenceGrid->get(i);
-  }
+  fluidCells.gather(divergenceGrid, *bVector);
+}
+
+const FluidCellIndex& MICSolver::getFluidCells() const{
+  return fluidCells;
 }
@@ -0,0 +1,235 @@
+#include <multigridPreconditioner.h>
+#include <pressureStencil.h>
+#include <grid.h>
+#include <algorithm>
+
+MultigridPreconditioner::MultigridPreconditioner(unsigned int smoothingSweeps, unsigned int coarseSweeps){
+  this->smoothingSweeps = smoothingSweeps;
+  this->coarseSweeps = coarseSweeps;
+}
+
+MultigridPreconditioner::~MultigridPreconditioner(){
+  clearLevels();
+}
+
+unsigned int MultigridPreconditioner::getLevelCount() const{
+  return levels.size();
+}
+
+/**
+ * Coarsen the cell types down the hierarchy and build the stencil of every level.
+ * The coarse operators are the Galerkin operators of piecewise constant
+ * transfers, the same stencil at a quarter of the scale of the level above.
+ */
+void MultigridPreconditioner::build(State const* const state, PressureStencil const* const stencil){
+  Grid<CellType> const *const cellTypeGrid = state->getCellTypeGrid();
+  resize(cellTypeGrid->getW(), cellTypeGrid->getH(), cellTypeGrid->getD());
+
+  levels[0].stencil = stencil;
+  for (unsigned int l = 1; l < levels.size(); l++) {
+    Level &level = levels[l];
+    coarsen(l == 1 ? cellTypeGrid : levels[l - 1].cellTypes, level.cellTypes);
+    level.coarseStencil->build(level.cellTypes, levels[l - 1].stencil->scale/4.0);
+    level.stencil = level.coarseStencil;
+  }
+
+  for (Level &level : levels) {
+    const unsigned int size = level.stencil->size();
+    level.x.resize(size);
+    level.r.resize(size);
+    level.b.resize(size);
+    level.red.clear();
+    level.black.clear();
+    for (unsigned int n = 0; n < size; n++) {
+      const GridCoordinate c = level.stencil->fluidCells.getCell(n);
+      ((c.x + c.y + c.z) % 2 == 0 ? level.red : level.black).push_back(n);
+    }
+  }
+}
+
+void MultigridPreconditioner::apply(const std::vector<double> &r, std::vector<double> &z){
+  levels[0].b = r;
+  vCycle(0);
+  z = levels[0].x;
+}
+
+/**
+ * Build the level hierarchy, halving until a side reaches COARSEST_SIZE.
+ * The finest level uses the cell types of the state and the solver's stencil.
+ */
+void MultigridPreconditioner::resize(unsigned int w, unsigned int h, unsigned int d){
+  if (levels.size() > 1 && levels[1].cellTypes->getW() == (w + 1)/2 &&
+      levels[1].cellTypes->getH() == (h + 1)/2 && levels[1].cellTypes->getD() == (d + 1)/2) {
+    return;
+  }
+  clearLevels();
+  while (true) {
+    Level level;
+    level.cellTypes = nullptr;
+    level.coarseStencil = nullptr;
+    if (!levels.empty()) {
+      level.cellTypes = new Grid<CellType>(w, h, d, GridLayout::FLAT);
+      level.coarseStencil = new PressureStencil();
+    }
+    level.stencil = level.coarseStencil;
+    levels.push_back(level);
+    if (std::min(w, std::min(h, d)) <= COARSEST_SIZE) {
+      break;
+    }
+    w = (w + 1)/2;
+    h = (h + 1)/2;
+    d = (d + 1)/2;
+  }
+}
+
+void MultigridPreconditioner::clearLevels(){
+  for (Level &level : levels) {
+    delete level.cellTypes;
+    delete level.coarseStencil;
+  }
+  levels.clear();
+}
+
+void MultigridPreconditioner::coarsen(Grid<CellType> const* const fine, Grid<CellType> *coarse){
+  coarse->setForEach([&](unsigned int i, unsigned int j, unsigned int k){
+      bool fluid = false;
+      for (unsigned int fk = 2*k; fk < std::min(2*k + 2, fine->getD()); fk++) {
+        for (unsigned int fj = 2*j; fj < std::min(2*j + 2, fine->getH()); fj++) {
+          for (unsigned int fi = 2*i; fi < std::min(2*i + 2, fine->getW()); fi++) {
+            CellType type = fine->get(fi, fj, fk);
+            if (type == CellType::EMPTY) {
+              return CellType::EMPTY;
+            }
+            fluid = fluid || type == CellType::FLUID;
+          }
+        }
+      }
+      return fluid ? CellType::FLUID : CellType::SOLID;
+    });
+}
+
+void MultigridPreconditioner::vCycle(unsigned int l){
+  Level &level = levels[l];
+  std::fill(level.x.begin(), level.x.end(), 0.0);
+
+  if (l + 1 == levels.size()) {
+    for (unsigned int s = 0; s < coarseSweeps; s++) {
+      smooth(level, level.red);
+      smooth(level, level.black);
+    }
+    for (unsigned int s = 0; s < coarseSweeps; s++) {
+      smooth(level, level.black);
+      smooth(level, level.red);
+    }
+    return;
+  }
+
+  for (unsigned int s = 0; s < smoothingSweeps; s++) {
+    smooth(level, level.red);
+    smooth(level, level.black);
+  }
+  computeResidual(level);
+  restrictResidual(l);
+  vCycle(l + 1);
+  prolongAndCorrect(l);
+  for (unsigned int s = 0; s < smoothingSweeps; s++) {
+    smooth(level, level.black);
+    smooth(level, level.red);
+  }
+}
+
+/**
+ * One Gauss-Seidel sweep over the fluid cells of one colour.
+ * Cells of a colour only depend on the other colour, so the sweep runs in parallel.
+ */
+void MultigridPreconditioner::smooth(Level &level, const std::vector<int> &colour){
+  PressureStencil const &stencil = *level.stencil;
+  std::vector<double> &x = level.x;
+  const int count = colour.size();
+  #pragma omp parallel for
+  for (int c = 0; c < count; c++) {
+    const int n = colour[c];
+    if (stencil.diag[n] == 0.0) {
+      continue;
+    }
+    double t = level.b[n];
+    int m = stencil.previousI[n];
+    if (m != FluidCellIndex::NOT_FLUID) {
+      t -= stencil.plusI[m]*x[m];
+    }
+    m = stencil.previousJ[n];
+    if (m != FluidCellIndex::NOT_FLUID) {
+      t -= stencil.plusJ[m]*x[m];
+    }
+    m = stencil.previousK[n];
+    if (m != FluidCellIndex::NOT_FLUID) {
+      t -= stencil.plusK[m]*x[m];
+    }
+    m = stencil.nextI[n];
+    if (m != FluidCellIndex::NOT_FLUID) {
+      t -= stencil.plusI[n]*x[m];
+    }
+    m = stencil.nextJ[n];
+    if (m != FluidCellIndex::NOT_FLUID) {
+      t -= stencil.plusJ[n]*x[m];
+    }
+    m = stencil.nextK[n];
+    if (m != FluidCellIndex::NOT_FLUID) {
+      t -= stencil.plusK[n]*x[m];
+    }
+    x[n] = t/stencil.diag[n];
+  }
+}
+
+void MultigridPreconditioner::computeResidual(Level &level){
+  level.stencil->apply(level.x, level.r);
+  const int size = level.r.size();
+  #pragma omp parallel for
+  for (int n = 0; n < size; n++) {
+    level.r[n] = level.b[n] - level.r[n];
+  }
+}
+
+/**
+ * Average the residual of the children of every coarse fluid cell.
+ */
+void MultigridPreconditioner::restrictResidual(unsigned int l){
+  Level &fine = levels[l];
+  Level &coarse = levels[l + 1];
+  FluidCellIndex const &fineCells = fine.stencil->fluidCells;
+  FluidCellIndex const &coarseCells = coarse.stencil->fluidCells;
+  const int size = coarse.b.size();
+  #pragma omp parallel for
+  for (int n = 0; n < size; n++) {
+    const GridCoordinate c = coarseCells.getCell(n);
+    double sum = 0.0;
+    for (int fk = 2*c.z; fk < 2*c.z + 2; fk++) {
+      for (int fj = 2*c.y; fj < 2*c.y + 2; fj++) {
+        for (int fi = 2*c.x; fi < 2*c.x + 2; fi++) {
+          const int m = fineCells.get(fi, fj, fk);
+          sum += m == FluidCellIndex::NOT_FLUID ? 0.0 : fine.r[m];
+        }
+      }
+    }
+    coarse.b[n] = sum/8.0;
+  }
+}
+
+/**
+ * Add the coarse correction to the fluid cells below it.
+ */
+void MultigridPreconditioner::prolongAndCorrect(unsigned int l){
+  Level &fine = levels[l];
+  Level &coarse = levels[l + 1];
+  FluidCellIndex const &fineCells = fine.stencil->fluidCells;
+  FluidCellIndex const &coarseCells = coarse.stencil->fluidCells;
+  const int size = fine.x.size();
+  #pragma omp parallel for
+  for (int n = 0; n < size; n++) {
+    const GridCoordinate c = fineCells.getCell(n);
+    const int m = coarseCells.get(c.x/2, c.y/2, c.z/2);
+    if (m != FluidCellIndex::NOT_FLUID) {
+      fine.x[n] += coarse.x[m];
+    }
+  }
+}
@@ -15,8 +15,12 @@ void ObjExporter::exportState(std::string filename, State *state) {
 
   Mesh m;
 
-  SdfTessellation sdfTess(sdf);
-  m.addData(sdfTess.getVertices(), sdfTess.getFaces());
+  // the surface lies within one cell of the fluid
+  GridCoordinate lower, upper;
+  if (state->getFluidBounds(lower, upper)) {
+    SdfTessellation sdfTess(sdf, lower, upper);
+    m.addData(sdfTess.getVertices(), sdfTess.getFaces());
+  }
 
   std::vector<Bubble> bubbles = state->getBubbles();
   for (int i = 0; i < bubbles.size(); ++i) {
@@ -1,19 +1,39 @@
 #include <particleTracker.h>
 
 #include <stdlib.h>
+#include <algorithm>
 #include <particle.h>
 #include <iomanip>
 #include <grid.h>
 #include <ordinalGrid.h>
 #include <velocityGrid.h>
+#include <velocityCache.h>
 #include <bubbleTracker.h>
 #include <glm/ext.hpp>
 #include <state.h>
 
+namespace {
+  /**
+   * RK2 for all particles, with sample(positions, velocities, count) sampling
+   * the velocities of all particles in one batch.
+   */
+  template <class Sample>
+  void advectParticles(std::vector<glm::vec3> &positions, std::vector<glm::vec3> &v, float dt, Sample sample) {
+    const unsigned int count = positions.size();
+    std::vector<glm::vec3> midpoints(count);
+    v.resize(count);
+    sample(positions.data(), v.data(), count);
+    for (unsigned i = 0; i < count; ++i) {
+      midpoints[i] = positions[i] + v[i]*dt/2.0f;
+    }
+    sample(midpoints.data(), v.data(), count);
+    for (unsigned i = 0; i < count; ++i) {
+      positions[i] = positions[i] + dt*v[i];
+    }
+  }
+}
+
 ParticleTracker::ParticleTracker(unsigned w, unsigned h, unsigned d, unsigned int ppc) {
-  interfaceParticles = new std::vector<Particle*>();
-  escapedParticles = new std::vector<Particle*>();
-  deadParticles = new std::stack<Particle*>();
   particleCount = new Grid<unsigned>(w, h, d);
   corrPlus = new Grid<float>(w, h, d);
   corrMinus = new Grid<float>(w, h, d);
@@ -22,34 +42,26 @@ ParticleTracker::ParticleTracker(unsigned w, unsigned h, unsigned d, unsigned in
 }
 
 ParticleTracker::~ParticleTracker() {
-  for (auto &p : *interfaceParticles) {
-    delete p;
-  }
-
-  delete interfaceParticles;
-  delete deadParticles;
   delete particleCount;
+  delete corrPlus;
+  delete corrMinus;
 }
 
 void ParticleTracker::reinitializeParticles(OrdinalGrid<float> const* distance) {
   resetParticleCount();
 
-  for (unsigned i = 0; i < interfaceParticles->size(); ++i) {
-    Particle* p = interfaceParticles->at(i);
-
-    glm::vec3 pos = p->position;
-    
-    // early out conditions
-    if (!(p->alive)) {
-      continue;
-    }
+  const unsigned int stored = positions.size();
+  sampledDistances.resize(stored);
+  distance->getLerp(positions.data(), sampledDistances.data(), stored);
 
+  // keep the particles that stay, packed in their order
+  unsigned int kept = 0;
+  for (unsigned i = 0; i < stored; ++i) {
+    glm::vec3 pos = positions[i];
     GridCoordinate cell = GridCoordinate(round(pos.x), round(pos.y), round(pos.z));
 
     // particle outside grid?
     if (!(distance->isValid(cell))) {
-      deadParticles->push(p);
-      p->alive = false;
       continue;
     }
     
@@ -57,15 +69,16 @@ void ParticleTracker::reinitializeParticles(OrdinalGrid<float> const* distance)
 
     // update particle radii, cell particleCount
     // and remove particles outside offset
-    unsigned count = particleCount->get(cell);
-    if (cellActive && count < particlesPerCell) {
-      p->phi = distance->getLerp(pos);
-      particleCount->set(cell, count + 1);
-    } else {
-      deadParticles->push(p);
-      p->alive = false;
+    unsigned cellCount = particleCount->get(cell);
+    if (cellActive && cellCount < particlesPerCell) {
+      positions[kept] = pos;
+      phis[kept] = sampledDistances[i];
+      kept++;
+      particleCount->set(cell, cellCount + 1);
     }
   }
+  positions.resize(kept);
+  phis.resize(kept);
 
   // spawn new particles
   for (unsigned j = 0; j < h; ++j) {
@@ -81,7 +94,8 @@ void ParticleTracker::reinitializeParticles(OrdinalGrid<float> const* distance)
             float r = (d > MAX_RADUIS) ? MAX_RADUIS : d;
             // float r = distance->getLerp(pos);
 
-            insertParticle(pos, r);
+            positions.push_back(pos);
+            phis.push_back(r);
             ++count;
           }
 
@@ -91,8 +105,7 @@ void ParticleTracker::reinitializeParticles(OrdinalGrid<float> const* distance)
     }
   }
 
-  // std::cout << "Particles: " << interfaceParticles->size() << std::endl;
-  // std::cout << "Dead: " << deadParticles->size() << std::endl;
+  // std::cout << "Particles: " << positions.size() << std::endl;
 
   // for(unsigned j = 0; j < h; ++j) {
   //   for(unsigned i = 0; i < w; ++i) {
@@ -106,38 +119,39 @@ void ParticleTracker::reinitializeParticles(OrdinalGrid<float> const* distance)
 }
 
 void ParticleTracker::advect(VelocityGrid const* velocities, float dt) {
-  for (unsigned i = 0; i < interfaceParticles->size(); ++i) {
-    Particle *p = interfaceParticles->at(i);
-
-    // RK2
-    if (p->alive) {
-      glm::vec3 v = velocities->getLerp(p->position);
-      glm::vec3 midPos = p->position + v*dt/2.0f;
-      glm::vec3 midV = velocities->getLerp(midPos);
-      p->position = p->position + dt*midV;
-    }
-  }
+  advectParticles(positions, sampledVelocities, dt, [=](const glm::vec3 *samples, glm::vec3 *v, unsigned int count) {
+      velocities->getLerp(samples, v, count);
+    });
+}
+
+/**
+ * Advect the particles through cell-centred velocities, one lookup per sample.
+ */
+void ParticleTracker::advect(VelocityCache const* velocityCache, float dt) {
+  advectParticles(positions, sampledVelocities, dt, [=](const glm::vec3 *samples, glm::vec3 *v, unsigned int count) {
+      velocityCache->sampleVelocity(samples, v, count);
+    });
 }
 
 void ParticleTracker::feedEscaped(BubbleTracker* bt, State *state) {
   OrdinalGrid<float> const *distances = state->getSignedDistanceGrid();
   VelocityGrid const *velocities = state->getVelocityGrid();
   
-  // check all particles
-  for (unsigned i = 0; i < interfaceParticles->size(); ++i) {
-    Particle* p = interfaceParticles->at(i);
-    if (!(p->alive)) {
-      continue;
-    }
+  const unsigned int count = positions.size();
+  sampledDistances.resize(count);
+  distances->getLerp(positions.data(), sampledDistances.data(), count);
 
-    glm::vec3 pos = p->position;
+  // check all particles
+  for (unsigned i = 0; i < count; ++i) {
+    glm::vec3 pos = positions[i];
     GridCoordinate cell = GridCoordinate(round(pos.x), round(pos.y), round(pos.z));
 
-    float radius = fabs(p->phi);
-    float dist = distances->getLerp(pos.x, pos.y, pos.z);
+    float phi = phis[i];
+    float radius = fabs(phi);
+    float dist = sampledDistances[i];
     
     // bubble if                  (air particle) (in water)  (not touching surface)
-    if (distances->isValid(cell) && p->phi > 0 && dist < 0 && fabs(dist) > radius && radius > 0.04) {
+    if (distances->isValid(cell) && phi > 0 && dist < 0 && fabs(dist) > radius && radius > 0.04) {
       glm::vec3 velocity = velocities->getLerp(pos);
       bt->spawnBubble(state, pos, radius*10.0, velocity);
     }
@@ -150,25 +164,25 @@ void ParticleTracker::correct(OrdinalGrid<float> *distance) {
   corrPlus->setForEach([&](unsigned i, unsigned j, unsigned k) {
     return distance->get(i, j, k);
   });
-  corrMinus->setForEach([&](unsigned i, unsigned j, unsigned k) {
-    return distance->get(i, j, k);
+  corrMinus->setForEachIndexed([&](unsigned, unsigned, unsigned, unsigned index) {
+    return corrPlus->get(index);
   });
 
-  // check all particles
-  for (unsigned i = 0; i < interfaceParticles->size(); ++i) {
-    Particle* p = interfaceParticles->at(i);
-    if (!(p->alive)) {
-      continue;
-    }
+  const unsigned int count = positions.size();
+  sampledDistances.resize(count);
+  distance->getLerp(positions.data(), sampledDistances.data(), count);
 
-    glm::vec3 pos = p->position;
+  // check all particles
+  for (unsigned i = 0; i < count; ++i) {
+    glm::vec3 pos = positions[i];
     GridCoordinate cell = GridCoordinate(round(pos.x), round(pos.y), round(pos.z));
 
-    float radius = fabs(p->phi);
-    float dist = distance->getLerp(pos.x, pos.y, pos.z);
+    float phi = phis[i];
+    float radius = fabs(phi);
+    float dist = sampledDistances[i];
     
     // if escaped                  (different signs)  (particle does not touch surface)
-    if (distance->isValid(cell) && p->phi*dist < 0 && fabs(dist) > radius) {
+    if (distance->isValid(cell) && phi*dist < 0 && fabs(dist) > radius) {
       GridCoordinate leftUpFront = GridCoordinate(floor(pos.x), floor(pos.y), floor(pos.z));
       GridCoordinate rightUpFront = GridCoordinate(leftUpFront.x + 1, leftUpFront.y, leftUpFront.z);
       GridCoordinate leftDownFront = GridCoordinate(leftUpFront.x, leftUpFront.y + 1, leftUpFront.z);
@@ -188,7 +202,7 @@ void ParticleTracker::correct(OrdinalGrid<float> *distance) {
           distance->isValid(leftDownBack) &&
           distance->isValid(rightDownBack)) {
 
-        int sgn = p->phi > 0 ? 1 : -1;
+        int sgn = phi > 0 ? 1 : -1;
         float leftUpFrontContrib = sgn*(radius - glm::length(glm::vec3(leftUpFront) - pos));
         float rightUpFrontContrib = sgn*(radius - glm::length(glm::vec3(rightUpFront) - pos));
         float leftDownFrontContrib = sgn*(radius - glm::length(glm::vec3(leftDownFront) - pos));
@@ -227,41 +241,20 @@ void ParticleTracker::correct(OrdinalGrid<float> *distance) {
   }
 
   distance->setForEach([&](unsigned i, unsigned j, unsigned k) {
-    float p = corrPlus->get(i, j, k);
-    float m = corrMinus->get(i, j, k);
+    unsigned index = corrPlus->indexTranslation(i, j, k);
+    float p = corrPlus->get(index);
+    float m = corrMinus->get(index);
     return fabs(m) < fabs(p) ? m : p;
   });
 }
 
 std::vector<Particle> ParticleTracker::getParticles() const {
-  std::vector<Particle> validParticles;
-  int nAliveParticles = interfaceParticles->size() - deadParticles->size();
-  validParticles.reserve(nAliveParticles);
-
-  for (int i = 0; i < interfaceParticles->size(); i++) {
-    Particle p = *interfaceParticles->at(i);
-    if (p.alive) {
-      validParticles.push_back(p);
-    }
-  }
-  return validParticles;
-}
-
-
-void ParticleTracker::insertParticle(glm::vec3 pos, float radius) {
-  Particle *p;
-
-  if (deadParticles->size() > 0) {
-    p = deadParticles->top();
-    p->position = pos;
-    p->phi = radius;
-    p->alive = true;
-    p->phi = radius;
-    deadParticles->pop();
-  } else {
-    p = new Particle(pos, radius);
-    interfaceParticles->push_back(p);
+  std::vector<Particle> particles;
+  particles.reserve(positions.size());
+  for (unsigned i = 0; i < positions.size(); i++) {
+    particles.push_back(Particle(positions[i], phis[i]));
   }
+  return particles;
 }
 
 glm::vec3 ParticleTracker::jitterCoordinate(glm::vec3 coord) {
@@ -274,7 +267,7 @@ glm::vec3 ParticleTracker::jitterCoordinate(glm::vec3 coord) {
 
 
 void ParticleTracker::resetParticleCount() {
-  particleCount->setForEach([] (unsigned i, unsigned j, unsigned k) {
-    return 0u;
+  particleCount->setForEachRow([&] (unsigned, unsigned, unsigned *row) {
+    std::fill(row, row + w, 0u);
   });
 }
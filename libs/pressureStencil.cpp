@@ -0,0 +1,78 @@
+#include <pressureStencil.h>
+#include <ordinalGrid.h>
+#include <state.h>
+#include <solidFaces.h>
+
+void PressureStencil::build(State const* const state, const float dt){
+  build(state->getCellTypeGrid(), dt, state->getSolidFaces());
+}
+
+/**
+ * Number the fluid cells and fill in their stencils.
+ */
+void PressureStencil::build(Grid<CellType> const* const cellTypeGrid, const double scale, SolidFaces const* const solidFaces){
+  fluidCells.build(cellTypeGrid);
+  const int size = fluidCells.size();
+  this->scale = scale;
+
+  for (std::vector<double> *v : {&diag, &plusI, &plusJ, &plusK}) {
+    v->resize(size);
+  }
+  for (std::vector<int> *v : {&previousI, &previousJ, &previousK, &nextI, &nextJ, &nextK}) {
+    v->resize(size);
+  }
+
+  #pragma omp parallel for
+  for (int n = 0; n < size; n++) {
+    const GridCoordinate c = fluidCells.getCell(n);
+    const int i = c.x, j = c.y, k = c.z;
+
+    // outside the domain counts like air, solids are left out
+    const uint8_t mask = solidFaces ? solidFaces->get(i, j, k) : SolidFaces::maskAt(cellTypeGrid, i, j, k);
+    diag[n] = scale*SolidFaces::openFaces(mask);
+
+    previousI[n] = fluidCells.get(i - 1, j, k);
+    previousJ[n] = fluidCells.get(i, j - 1, k);
+    previousK[n] = fluidCells.get(i, j, k - 1);
+    nextI[n] = fluidCells.get(i + 1, j, k);
+    nextJ[n] = fluidCells.get(i, j + 1, k);
+    nextK[n] = fluidCells.get(i, j, k + 1);
+    plusI[n] = nextI[n] == FluidCellIndex::NOT_FLUID ? 0.0 : -scale;
+    plusJ[n] = nextJ[n] == FluidCellIndex::NOT_FLUID ? 0.0 : -scale;
+    plusK[n] = nextK[n] == FluidCellIndex::NOT_FLUID ? 0.0 : -scale;
+  }
+}
+
+void PressureStencil::apply(const std::vector<double> &x, std::vector<double> &result) const{
+  const int size = fluidCells.size();
+  #pragma omp parallel for
+  for (int n = 0; n < size; n++) {
+    double value = diag[n]*x[n];
+    int m = previousI[n];
+    if (m != FluidCellIndex::NOT_FLUID) {
+      value += plusI[m]*x[m];
+    }
+    m = previousJ[n];
+    if (m != FluidCellIndex::NOT_FLUID) {
+      value += plusJ[m]*x[m];
+    }
+    m = previousK[n];
+    if (m != FluidCellIndex::NOT_FLUID) {
+      value += plusK[m]*x[m];
+    }
+    if (nextI[n] != FluidCellIndex::NOT_FLUID) {
+      value += plusI[n]*x[nextI[n]];
+    }
+    if (nextJ[n] != FluidCellIndex::NOT_FLUID) {
+      value += plusJ[n]*x[nextJ[n]];
+    }
+    if (nextK[n] != FluidCellIndex::NOT_FLUID) {
+      value += plusK[n]*x[nextK[n]];
+    }
+    result[n] = value;
+  }
+}
+
+unsigned int PressureStencil::size() const{
+  return fluidCells.size();
+}
@@ -1,8 +1,14 @@
 #include <sdfTessellation.h>
 #include <marchingcubes/marchingcubes.h>
 
-SdfTessellation::SdfTessellation(const OrdinalGrid<float> *sdf) {
+SdfTessellation::SdfTessellation(const OrdinalGrid<float> *sdf) :
+  SdfTessellation(sdf, GridCoordinate(0), GridCoordinate(sdf->getW() - 1, sdf->getH() - 1, sdf->getD() - 1)) {
+}
+
+SdfTessellation::SdfTessellation(const OrdinalGrid<float> *sdf, GridCoordinate lower, GridCoordinate upper) {
   this->sdf = sdf;
+  this->lower = glm::max(lower - GridCoordinate(1), GridCoordinate(0));
+  this->upper = glm::min(upper, GridCoordinate(sdf->getW() - 1, sdf->getH() - 1, sdf->getD() - 1));
 }
 
 
@@ -21,14 +27,17 @@ std::vector<Face > SdfTessellation::getFaces() {
 }
 
 void SdfTessellation::tessellate() {
-  int w = sdf->getW();
-  int h = sdf->getH();
-  int d = sdf->getD();
-
-  // marching cubes
-  for (unsigned int k = 0; k < d; ++k) {
-    for (unsigned int j = 0; j < h; ++j) {
-      for (unsigned int i = 0; i < w; ++i) {
+  // marching cubes, the cube at i, j, k spans to i + 1, j + 1, k + 1
+  for (unsigned int k = lower.z; (int)k <= upper.z; ++k) {
+    for (unsigned int j = lower.y; (int)j <= upper.y; ++j) {
+      for (unsigned int i = lower.x; (int)i <= upper.x; ++i) {
+        // a cube inside a single uniform sparse brick can not contain the surface
+        if (sdf->isBrickUniform(i, j, k) &&
+            i % OrdinalGrid<float>::BRICK_SIZE != OrdinalGrid<float>::BRICK_SIZE - 1 &&
+            j % OrdinalGrid<float>::BRICK_SIZE != OrdinalGrid<float>::BRICK_SIZE - 1 &&
+            k % OrdinalGrid<float>::BRICK_SIZE != OrdinalGrid<float>::BRICK_SIZE - 1) {
+          continue;
+        }
         if(sdf->isValid(i+1,j,k) &&
            sdf->isValid(i,j+1,k) &&
            sdf->isValid(i+1,j+1,k) &&
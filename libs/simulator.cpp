@@ -6,13 +6,61 @@
 #include <iostream>
 #include <glm/ext.hpp>
 #include <cassert>
+#include <limits>
+#include <cmath>
 #include <levelSet.h>
+#include <solidFaces.h>
 #include <jacobiIteration.h>
 #include <micSolver.h>
+#include <stencilPCGSolver.h>
 #include <particleTracker.h>
 #include <bubbleTracker.h>
+#include <velocityCache.h>
+
+constexpr float Simulator::MIN_DISTANCE_ADVECTION_BAND;
+
+namespace {
+  /**
+   * Give an advection source a one cell ZERO halo and fill it from the interior.
+   * getCrerp then reads the halo instead of bounds checking every sample.
+   */
+  template <class T>
+  void refreshAdvectionHalo(OrdinalGrid<T> *grid) {
+    if (grid->getLayout() == GridLayout::FLAT) {
+      grid->setHalo(1, HaloPolicy::ZERO);
+    }
+  }
+
+  /**
+   * Box of faces of one velocity component, with faces numbered (k*fh + j)*fw + i.
+   */
+  struct FaceBox {
+    GridCoordinate lower, upper;
+    int fw, fh;
 
-Simulator::Simulator(const State& initialState, float scale, bool usePls, bool useBubbleSpawning) : gridSize(scale) {
+    bool contains(int i, int j, int k) const {
+      return i >= lower.x && j >= lower.y && k >= lower.z && i <= upper.x && j <= upper.y && k <= upper.z;
+    }
+
+    /**
+     * Call visit(m) for every neighbour m of face n along the axes, within the box.
+     */
+    template <class Visit>
+    void forEachNeighbor(int n, Visit visit) const {
+      const int i = n % fw;
+      const int j = (n/fw) % fh;
+      const int k = n/(fw*fh);
+      if (contains(i - 1, j, k)) visit(n - 1);
+      if (contains(i + 1, j, k)) visit(n + 1);
+      if (contains(i, j - 1, k)) visit(n - fw);
+      if (contains(i, j + 1, k)) visit(n + fw);
+      if (contains(i, j, k - 1)) visit(n - fw*fh);
+      if (contains(i, j, k + 1)) visit(n + fw*fh);
+    }
+  };
+}
+
+Simulator::Simulator(const State& initialState, float scale, bool usePls, bool useBubbleSpawning, bool warmStartPressure, Preconditioner *pressurePreconditioner) : gridSize(scale) {
   stateFrom = new State(initialState);
   stateTo = new State(initialState);
 
@@ -28,7 +76,23 @@ Simulator::Simulator(const State& initialState, float scale, bool usePls, bool u
   pressureGridFrom = new OrdinalGrid<double>(w, h, d);
   pressureGridTo = new OrdinalGrid<double>(w, h, d);
   // pressureSolver = new JacobiIteration(100);
-  pressureSolver = new MICSolver(w*h*d);
+  // pressureSolver = new MICSolver(w*h*d);
+  // pressureGridTo keeps the last solution, so a warm start begins from the previous step
+  // the solver takes ownership of the preconditioner, MIC(0) if none is given
+  StencilPCGSolver *stencilSolver = new StencilPCGSolver(pressurePreconditioner);
+  stencilSolver->setWarmStart(warmStartPressure);
+  pressureSolver = stencilSolver;
+
+  extrapolationDepth = EXTRAPOLATION_DEPTH;
+  distanceAdvectionBand = std::numeric_limits<float>::infinity();
+
+  restrictToActiveRegion = true;
+  activeLower = GridCoordinate(0);
+  activeUpper = GridCoordinate(w - 1, h - 1, d - 1);
+  activeCells = 0;
+  domainCells = 0;
+  maxFaceVelocityKnown = false;
+  velocityCache = nullptr;
 
   pTracker = new ParticleTracker(w, h, d, PARTICLES_PER_CELL);
   bTracker = new BubbleTracker();
@@ -44,7 +108,9 @@ Simulator::~Simulator() {
   delete pressureGridFrom;
   delete pressureGridTo;
   delete pTracker;
+  delete pressureSolver;
   delete bTracker;
+  delete velocityCache;
 }
 
 /**
@@ -57,6 +123,12 @@ State* Simulator::getCurrentState() {
 void Simulator::setCurrentState(const State& state) {
   delete stateFrom;
   stateFrom = new State(state);
+  // stateTo is only partly rewritten by a step, it must not keep the replaced state
+  delete stateTo;
+  stateTo = new State(state);
+  activeLower = GridCoordinate(0);
+  activeUpper = GridCoordinate(w - 1, h - 1, d - 1);
+  maxFaceVelocityKnown = false;
 }
 
 /**
@@ -76,18 +148,28 @@ void Simulator::step(float dt, bool onlyBubbles) {
 
   if (!onlyBubbles) {
     // stateFrom->levelSet->reinitialize();
-    extrapolateVelocity(stateFrom, stateFrom);
+    extrapolateVelocity(stateFrom, dt);
+    updateActiveRegion(stateFrom, dt);
+    if (velocityCache) {
+      // the face samples at the border of the region read the cells just outside it
+      velocityCache->update(stateFrom->velocityGrid, activeLower - GridCoordinate(1), activeUpper + GridCoordinate(1));
+    }
 
     advect(stateFrom, stateTo, dt);
 
     // PLS + bubble stack
     // 1. evolve particles + bubbles
     if (usePls) {
-      pTracker->advect(stateFrom->velocityGrid, dt);
+      if (velocityCache) {
+        pTracker->advect(velocityCache, dt);
+      } else {
+        pTracker->advect(stateFrom->velocityGrid, dt);
+      }
     }
   }
 
-  bTracker->advect(stateFrom, stateTo, pressureGridTo, gravity, dt);
+  // the cache is only up to date when the fluid was stepped as well
+  bTracker->advect(stateFrom, stateTo, pressureGridTo, gravity, dt, onlyBubbles ? nullptr : velocityCache);
 
   if (!onlyBubbles) {
     if (usePls) {
@@ -105,14 +187,15 @@ void Simulator::step(float dt, bool onlyBubbles) {
       pTracker->reinitializeParticles(stateTo->getSignedDistanceGrid());
     }
 
-    applyGravity(stateTo, gravity, dt);
     stateTo->levelSet->updateCellTypes();
 
-    calculateNegativeDivergence(stateTo, divergenceGrid);
+    // gravity is part of the divergence and the gradient subtraction
+    calculateNegativeDivergence(stateTo, divergenceGrid, gravity, dt);
     pressureSolver->solve(divergenceGrid, stateTo, pressureGridTo, dt);
-    gradientSubtraction(stateTo, dt);
+    maxFaceVelocity = gradientSubtraction(stateTo, gravity, dt);
+    maxFaceVelocityKnown = true;
 
-    deltaT = calculateDeltaT(maxVelocity(stateTo->velocityGrid), gravity);
+    deltaT = calculateDeltaT(maxFaceVelocity, gravity);
     stateTo->frameNumber = stateFrom->frameNumber + 1;
   }
 
@@ -127,536 +210,533 @@ void Simulator::step(float dt, bool onlyBubbles) {
  * @param dt time step length
  */
 void Simulator::advect(State const* readFrom, State* writeTo, float dt){
-#pragma omp parallel sections
-  {
-    // X
-#pragma omp section
-    writeTo->velocityGrid->u->setForEach([&](unsigned int i, unsigned int j, unsigned int k){
-        glm::vec3 position = util::advect::mac::backTrackU(readFrom->velocityGrid, i, j, k, dt);
-        return readFrom->velocityGrid->u->getCrerp(position);
-      });
-
-    // Y
-#pragma omp section
-    writeTo->velocityGrid->v->setForEach([&](unsigned int i, unsigned int j, unsigned int k){
-        glm::vec3 position = util::advect::mac::backTrackV(readFrom->velocityGrid, i, j, k, dt);
-        return readFrom->velocityGrid->v->getCrerp(position);
-      });
-
-    // Z
-#pragma omp section
-    writeTo->velocityGrid->w->setForEach([&](unsigned int i, unsigned int j, unsigned int k) {
-        glm::vec3 position = util::advect::mac::backTrackW(readFrom->velocityGrid, i, j, k, dt);
-        return readFrom->velocityGrid->w->getCrerp(position);
-      });
+  refreshAdvectionHalo(readFrom->velocityGrid->u);
+  refreshAdvectionHalo(readFrom->velocityGrid->v);
+  refreshAdvectionHalo(readFrom->velocityGrid->w);
+  refreshAdvectionHalo(readFrom->levelSet->distanceGrid);
+
+  VelocityGrid const *velocities = readFrom->velocityGrid;
+  OrdinalGrid<float> const *distances = readFrom->levelSet->distanceGrid;
+  OrdinalGrid<float> *targets[4] = {
+    writeTo->velocityGrid->u, writeTo->velocityGrid->v, writeTo->velocityGrid->w, writeTo->levelSet->distanceGrid
+  };
+  OrdinalGrid<float> const *sources[4] = {velocities->u, velocities->v, velocities->w, distances};
+
+  // within the active region, the faces of a velocity component reach one further
+  const GridCoordinate reach[4] = {GridCoordinate(1, 0, 0), GridCoordinate(0, 1, 0), GridCoordinate(0, 0, 1), GridCoordinate(0)};
+  const GridCoordinate first = glm::max(activeLower, GridCoordinate(0));
+  GridCoordinate upper[4];
+  GridCoordinate last = first;
+  bool flat = true;
+  for (int c = 0; c < 4; c++) {
+    upper[c] = glm::min(activeUpper + reach[c],
+                        GridCoordinate(targets[c]->getW() - 1, targets[c]->getH() - 1, targets[c]->getD() - 1));
+    last = glm::max(last, upper[c]);
+    flat = flat && targets[c]->getLayout() == GridLayout::FLAT;
+  }
 
-    // level set distance grid
-#pragma omp section
-    writeTo->levelSet->distanceGrid->setForEach([&](unsigned int i, unsigned int j, unsigned int k){
-        glm::vec3 position = util::advect::backTrack(readFrom->velocityGrid, i, j, k, dt);
-        return readFrom->levelSet->distanceGrid->getCrerp(position);
+  // writeTo holds the state of two steps ago, the cells outside the active region
+  // keep the values of readFrom instead. Bricked rows are written back whole, so
+  // this comes before the advection of the region.
+  for (int c = 0; c < 4; c++) {
+    const int rowEnd = targets[c]->getW();
+    targets[c]->setForEachRow([&](unsigned int j, unsigned int k, float *row) {
+        if ((int)j < first.y || (int)j > upper[c].y || (int)k < first.z || (int)k > upper[c].z) {
+          sources[c]->getRow(j, k, row);
+          return;
+        }
+        for (int i = 0; i < first.x; i++) {
+          row[i] = sources[c]->get(i, j, k);
+        }
+        for (int i = upper[c].x + 1; i < rowEnd; i++) {
+          row[i] = sources[c]->get(i, j, k);
+        }
       });
   }
-}
-
-/**
- * Apply gravity to fluid cells
- * @param state  state with velocity grid to be augmented
- * @param g      gravity vector
- * @param deltaT time step, dt
- */
-void Simulator::applyGravity(State *state, glm::vec3 g, float deltaT){
-  VelocityGrid *velocityGrid = state->velocityGrid;
-  Grid<CellType> const *const cellTypeGrid = state->getCellTypeGrid();
-
-  // u velocities
-  velocityGrid->u->setForEach([&](unsigned int i, unsigned int j, unsigned int k){
-      if (i < w && cellTypeGrid->get(i, j, k) == CellType::FLUID) {
-        return velocityGrid->u->get(i, j, k)+g.x*deltaT;
-      }
-      return velocityGrid->u->get(i, j, k);
-    });
-
-  // v velocities
-  velocityGrid->v->setForEach([&](unsigned int i, unsigned int j, unsigned int k){
-      if (j < h && cellTypeGrid->get(i, j, k) == CellType::FLUID) {
-        return velocityGrid->v->get(i, j, k)+g.y*deltaT;
-      }
-      return velocityGrid->v->get(i, j, k);
-    });
+  if (activeUpper.x < activeLower.x || activeUpper.y < activeLower.y || activeUpper.z < activeLower.z) {
+    return;
+  }
+  void (*const backTrackRow[4])(VelocityGrid const* const, int, int, int, unsigned int, float, glm::vec3*) = {
+    util::advect::mac::backTrackRowU, util::advect::mac::backTrackRowV, util::advect::mac::backTrackRowW,
+    util::advect::backTrackRow
+  };
+  void (*const backTrackCachedRow[4])(VelocityCache const*, int, int, int, unsigned int, float, glm::vec3*) = {
+    util::advect::mac::backTrackRowU, util::advect::mac::backTrackRowV, util::advect::mac::backTrackRowW,
+    util::advect::backTrackRow
+  };
+
+  // The distances are reinitialized from the interface after advection, only their
+  // sign matters further away. A cell the interface cannot reach this step keeps its
+  // distance, which has the right sign: the Catmull-Rom stencil reads floor - 1 to
+  // ceil + 1 around the backtrace along each axis, at most 2*sqrt(3) cells away, and
+  // the distances change by at most one per cell. So the whole stencil of a cell
+  // beyond the limit is at least the band width from the interface, on its side.
+  float bandLimit = std::numeric_limits<float>::infinity();
+  if (usePls && distanceAdvectionBand < bandLimit) {
+    if (!maxFaceVelocityKnown) {
+      maxFaceVelocity = maxVelocity(velocities);
+      maxFaceVelocityKnown = true;
+    }
+    bandLimit = distanceAdvectionBand + glm::length(maxFaceVelocity)*dt + CRERP_STENCIL_REACH;
+  }
 
-  // w velocities
-  velocityGrid->w->setForEach([&](unsigned int i, unsigned int j, unsigned int k){
-      if (k < d && cellTypeGrid->get(i, j, k) == CellType::FLUID) {
-        return velocityGrid->w->get(i, j, k)+g.z*deltaT;
+  // One parallel loop over tiles of rows does all components, so that the threads are
+  // not split between them and the velocities around a row are sampled while in cache.
+  // Tiles cover whole bricks, rows of the same brick are never written by two threads.
+  const int tile = flat ? 1 : Grid<float>::BRICK_SIZE;
+  const int firstTileJ = first.y/tile, lastTileJ = last.y/tile;
+  const int firstTileK = first.z/tile, lastTileK = last.z/tile;
+#pragma omp parallel
+  {
+    std::vector<glm::vec3> positions(last.x + 1 - first.x);
+    std::vector<float> buffer(w + 1);
+
+#pragma omp for collapse(2) schedule(dynamic)
+    for (int tk = firstTileK; tk <= lastTileK; tk++) {
+      for (int tj = firstTileJ; tj <= lastTileJ; tj++) {
+        for (int k = std::max(tk*tile, first.z); k <= std::min(tk*tile + tile - 1, last.z); k++) {
+          for (int j = std::max(tj*tile, first.y); j <= std::min(tj*tile + tile - 1, last.y); j++) {
+            // backtrace and sample count cells from i0 through the batched samplers
+            auto sample = [&](int c, int i0, unsigned int count, float *row) {
+              if (velocityCache) {
+                backTrackCachedRow[c](velocityCache, i0, j, k, count, dt, positions.data());
+              } else {
+                backTrackRow[c](velocities, i0, j, k, count, dt, positions.data());
+              }
+              sources[c]->getCrerp(positions.data(), row + i0, count);
+            };
+            for (int c = 0; c < 3; c++) {
+              if (j > upper[c].y || k > upper[c].z) {
+                continue;
+              }
+              targets[c]->setRowInBox(j, k, first.x, upper[c].x, buffer.data(), [&](float *row){
+                  sample(c, first.x, upper[c].x + 1 - first.x, row);
+                });
+            }
+            if (j > upper[3].y || k > upper[3].z) {
+              continue;
+            }
+            // the distances in runs of cells within the band
+            targets[3]->setRowInBox(j, k, first.x, upper[3].x, buffer.data(), [&](float *row){
+                for (int i = first.x; i <= upper[3].x;) {
+                  if (glm::abs(distances->get(i, j, k)) > bandLimit) {
+                    row[i] = distances->get(i, j, k);
+                    i++;
+                    continue;
+                  }
+                  int end = i + 1;
+                  while (end <= upper[3].x && glm::abs(distances->get(end, j, k)) <= bandLimit) {
+                    end++;
+                  }
+                  sample(3, i, end - i, row);
+                  i = end;
+                }
+              });
+          }
+        }
       }
-      return velocityGrid->w->get(i, j, k);
-    });
+    }
+  }
 }
 
 /**
- * Calculate divergence.
+ * Calculate the divergence the velocities have once gravity is applied to them.
+ * Gravity accelerates the face before each fluid cell along each axis. The velocities
+ * are only read, gradientSubtraction writes gravity and pressure to the faces at once.
  * @param readFrom State to read from
  * @param toDivergenceGrid An ordinal grid of floats to write the divergences to
+ * @param g      gravity vector
+ * @param deltaT time step, dt
  */
-void Simulator::calculateNegativeDivergence(State const* readFrom, OrdinalGrid<float>* toDivergenceGrid) {
-  const float scale = 1.0f;
+void Simulator::calculateNegativeDivergence(State const* readFrom, OrdinalGrid<float>* toDivergenceGrid, glm::vec3 g, float deltaT) {
   OrdinalGrid<float> *u = readFrom->velocityGrid->u;
   OrdinalGrid<float> *v = readFrom->velocityGrid->v;
   OrdinalGrid<float> *w = readFrom->velocityGrid->w;
   Grid<CellType> const *const cellTypeGrid = readFrom->getCellTypeGrid();
+  const glm::vec3 acceleration = g*deltaT;
 
   float volumeError = readFrom->levelSet->getVolumeError();
 
-  toDivergenceGrid->setForEach([&](unsigned int i, unsigned int j, unsigned int k){
-      if (cellTypeGrid->get(i, j, k) == CellType::FLUID) {
-        float entering = u->get(i, j, k) + v->get(i, j, k) + w->get(i, j, k);
-        float leaving = u->get(i + 1, j, k) + v->get(i, j + 1, k) + w->get(i, j, k + 1);
-
-        float divergence = leaving - entering;
+  auto isFluid = [&](unsigned int i, unsigned int j, unsigned int k) {
+    return i < this->w && j < h && k < d && cellTypeGrid->get(i, j, k) == CellType::FLUID;
+  };
 
-        return - divergence + volumeError; // non-scientific adjustment for volume loss
-      } else {
-        return 0.0f;
+  // cells outside the active region keep their zero from when they were last in it
+  toDivergenceGrid->setForEachRowInBox(activeLower, activeUpper, [&](unsigned int j, unsigned int k, float *row){
+      for (int i = activeLower.x; i <= activeUpper.x; i++) {
+        if (cellTypeGrid->get(i, j, k) == CellType::FLUID) {
+          float entering = (u->get(i, j, k) + acceleration.x) +
+                           (v->get(i, j, k) + acceleration.y) +
+                           (w->get(i, j, k) + acceleration.z);
+          float leaving = (u->get(i + 1, j, k) + (isFluid(i + 1, j, k) ? acceleration.x : 0.0f)) +
+                          (v->get(i, j + 1, k) + (isFluid(i, j + 1, k) ? acceleration.y : 0.0f)) +
+                          (w->get(i, j, k + 1) + (isFluid(i, j, k + 1) ? acceleration.z : 0.0f));
+
+          float divergence = leaving - entering;
+
+          row[i] = - divergence + volumeError; // non-scientific adjustment for volume loss
+        } else {
+          row[i] = 0.0f;
+        }
       }
     });
 }
 
 /**
- * Subtract pressure gradients from velocity grid
+ * Apply gravity and subtract pressure gradients on the velocity faces of the active
+ * region. Every face is written once, from the cells on its two sides, and the
+ * largest face speeds are reduced in the same pass for the time step.
  * @param state State to work on
+ * @param g, gravity vector
  * @param dt, The time step
+ * @return largest speed of a face next to fluid, along each axis
  */
-void Simulator::gradientSubtraction(State *state, float dt) {
+glm::vec3 Simulator::gradientSubtraction(State *state, glm::vec3 g, float dt) {
 
   const float deltaX = 1.0f;
   const float density = 1.0f;
   const float scale = dt / (density * deltaX);
 
-  OrdinalGrid<float> *uVelocityGrid = state->velocityGrid->u;
-  OrdinalGrid<float> *vVelocityGrid = state->velocityGrid->v;
-  OrdinalGrid<float> *wVelocityGrid = state->velocityGrid->w;
   Grid<CellType> const *const cellTypeGrid = state->getCellTypeGrid();
+  SolidFaces const *const solidFaces = state->getSolidFaces();
 
-  // looping through pressure cells
-#pragma omp parallel for default(none) shared(uVelocityGrid, vVelocityGrid, wVelocityGrid)
-  for(unsigned int k = 0; k < d; ++k) {
-    for (unsigned int j = 0; j < h; ++j) {
-      for (unsigned int i = 0; i < w; ++i) {
-        // is current cell solid?
-        if (cellTypeGrid->get(i, j, k) == CellType::FLUID) {
-          float uL = uVelocityGrid->get(i, j, k);
-          float uR = uVelocityGrid->get(i+1, j, k);
-
-          float vU = vVelocityGrid->get(i, j, k);
-          float vD = vVelocityGrid->get(i, j+1, k);
-
-          float wF = wVelocityGrid->get(i, j, k);
-          float wB = wVelocityGrid->get(i, j, k + 1);
-
-          float p = pressureGridTo->get(i, j, k);
-
-          uL -= scale * p;
-          uR += scale * p;
-          vU -= scale * p;
-          vD += scale * p;
-          wF -= scale * p;
-          wB += scale * p;
-
-          uVelocityGrid->set(i, j, k, uL);
-          uVelocityGrid->set(i + 1, j, k, uR);
-          vVelocityGrid->set(i, j, k, vU);
-          vVelocityGrid->set(i, j + 1, k, vD);
-          wVelocityGrid->set(i, j, k, wF);
-          wVelocityGrid->set(i, j, k + 1, wB);
+  return glm::vec3(
+    subtractPressureGradient(state->velocityGrid->u, cellTypeGrid, solidFaces, GridCoordinate(1, 0, 0), SolidFaces::LEFT, g.x*dt, scale),
+    subtractPressureGradient(state->velocityGrid->v, cellTypeGrid, solidFaces, GridCoordinate(0, 1, 0), SolidFaces::UP, g.y*dt, scale),
+    subtractPressureGradient(state->velocityGrid->w, cellTypeGrid, solidFaces, GridCoordinate(0, 0, 1), SolidFaces::FRONT, g.z*dt, scale));
+}
+
+/**
+ * Faces of one velocity component, normal to axis, between the cells before and
+ * after them along axis. Faces of solid cells are zeroed. Faces before a fluid cell
+ * are accelerated, and faces next to fluid get the pressure difference of their
+ * cells, pressure outside the fluid being zero. The rest keep their velocity.
+ * @param solidBefore SolidFaces bit of the cell before the face
+ * @param acceleration gravity along axis times the time step
+ * @return largest speed of the faces next to fluid
+ */
+float Simulator::subtractPressureGradient(OrdinalGrid<float> *velocities, Grid<CellType> const* cellTypeGrid,
+                                          SolidFaces const* solidFaces, GridCoordinate axis, uint8_t solidBefore,
+                                          float acceleration, float scale) {
+  const GridCoordinate lower = activeLower;
+  const GridCoordinate upper = activeUpper;
+  const int last = upper.x + axis.x;
+
+  return velocities->setForEachRowReduceInBox(lower, upper + axis, 0.0f, [&](unsigned int j, unsigned int k, float *row){
+      float fastest = 0.0f;
+      for (int i = lower.x; i <= last; i++) {
+        const GridCoordinate after(i, j, k);
+        const GridCoordinate before = after - axis;
+        const bool hasBefore = before.x >= 0 && before.y >= 0 && before.z >= 0;
+        const bool hasAfter = after.x < (int)w && after.y < (int)h && after.z < (int)d;
+
+        // the mask of the cell after the face also knows the cell before it
+        const bool solid = hasAfter ?
+          (solidFaces->get(after.x, after.y, after.z) & (SolidFaces::SOLID_CELL | solidBefore)) != 0 :
+          (solidFaces->get(before.x, before.y, before.z) & SolidFaces::SOLID_CELL) != 0;
+        if (solid) {
+          row[i] = 0.0f;
+          continue;
         }
-      }
-    }
 
-#pragma omp parallel for default(none) shared(uVelocityGrid, vVelocityGrid, wVelocityGrid)
-    for(unsigned k = 0; k < d; ++k) {
-      for (unsigned int j = 0; j < h; ++j) {
-        for (unsigned int i = 0; i < w; ++i) {
-          // is current cell solid?
-          if (cellTypeGrid->get(i, j, k) == CellType::SOLID) {
-
-            uVelocityGrid->set(i, j, k, 0.0f);
-            uVelocityGrid->set(i + 1, j, k, 0.0f);
-            vVelocityGrid->set(i, j, k, 0.0f);
-            vVelocityGrid->set(i, j + 1, k, 0.0f);
-            wVelocityGrid->set(i, j, k, 0.0f);
-            wVelocityGrid->set(i, j, k + 1, 0.0f);
-          }
+        const bool fluidBefore = hasBefore && cellTypeGrid->get(before.x, before.y, before.z) == CellType::FLUID;
+        const bool fluidAfter = hasAfter && cellTypeGrid->get(after.x, after.y, after.z) == CellType::FLUID;
+        if (!fluidBefore && !fluidAfter) {
+          continue;
         }
+        float velocity = row[i];
+        if (fluidAfter) {
+          velocity += acceleration;
+        }
+        if (fluidBefore) {
+          velocity += scale * pressureGridTo->get(before.x, before.y, before.z);
+        }
+        if (fluidAfter) {
+          velocity -= scale * pressureGridTo->get(after.x, after.y, after.z);
+        }
+        row[i] = velocity;
+        fastest = std::max(fastest, std::abs(velocity));
       }
-    }
-  }
+      return fastest;
+    }, [](float a, float b) {
+      return std::max(a, b);
+    });
 }
 
 
-void Simulator::initializeExtrapolation(State *stateFrom) {
-
-  const Grid<CellType> *cellTypeGrid = stateFrom->getCellTypeGrid();
-  VelocityGrid *velocityGrid = stateFrom->velocityGrid;
-
-  // u velocities
-  for (unsigned k = 0; k < d; ++k) {
-    for (unsigned j = 0; j < h; ++j) {
-      for (unsigned i = 0; i <= w; ++i) {
-
-        GridCoordinate leftCell = GridCoordinate(i - 1, j, k);
-        GridCoordinate rightCell = GridCoordinate(i, j, k);
-
-        if (cellTypeGrid->clampGet(leftCell) == CellType::EMPTY &&
-            cellTypeGrid->clampGet(rightCell) == CellType::EMPTY) {
-
-          GridCoordinate farLeft = GridCoordinate(i - 2, j, k);
-          GridCoordinate upLeft = GridCoordinate(i - 1, j - 1, k);
-          GridCoordinate downLeft = GridCoordinate(i - 1, j + 1, k);
-          GridCoordinate frontLeft = GridCoordinate(i - 1, j, k - 1);
-          GridCoordinate backLeft = GridCoordinate(i - 1, j, k + 1);
-
-          GridCoordinate farRight = GridCoordinate(i + 1, j, k);
-          GridCoordinate upRight = GridCoordinate(i, j - 1, k);
-          GridCoordinate downRight = GridCoordinate(i, j + 1, k);
-          GridCoordinate frontRight = GridCoordinate(i, j - 1, k - 1);
-          GridCoordinate backRight = GridCoordinate(i, j + 1, k + 1);
-
-          float u = 0;
-          unsigned int nContributions = 0;
-
-          // left cell
-          if (cellTypeGrid->clampGet(farLeft) == CellType::FLUID) {
-            u += velocityGrid->u->get(i - 1, j, k);
-            ++nContributions;
-          }
-
-          // right cell
-          if (cellTypeGrid->clampGet(farRight) == CellType::FLUID) {
-            u += velocityGrid->u->get(i + 1, j, k);
-            ++nContributions;
-          }
-
-          // up cells
-          if (cellTypeGrid->clampGet(upLeft) == CellType::FLUID ||
-              cellTypeGrid->clampGet(upRight) == CellType::FLUID) {
-            u += velocityGrid->u->get(i, j - 1, k);
-            ++nContributions;
-          }
-
-          // down cells
-          if (cellTypeGrid->clampGet(downLeft) == CellType::FLUID ||
-              cellTypeGrid->clampGet(downRight) == CellType::FLUID) {
-            u += velocityGrid->u->get(i, j + 1, k);
-            ++nContributions;
-          }
-
-          //front cells
-          if (cellTypeGrid->clampGet(frontLeft) == CellType::FLUID ||
-              cellTypeGrid->clampGet(frontRight) == CellType::FLUID) {
-            u += velocityGrid->u->get(i, j, k - 1);
-            ++nContributions;
-          }
-
-          //back cells
-          if (cellTypeGrid->clampGet(backLeft) == CellType::FLUID ||
-              cellTypeGrid->clampGet(backRight) == CellType::FLUID) {
-            u += velocityGrid->u->get(i, j, k + 1);
-            ++nContributions;
-          }
+/**
+ * Extrapolate the velocities of the faces next to fluid outwards into the faces
+ * between two EMPTY cells. The layers of faces reach as far as the fastest face
+ * travels in dt plus one for the interpolation, and at least extrapolationDepth.
+ * Faces further away are left as they are, semi-Lagrangian advection does not reach them.
+ * @param state state whose velocities are extrapolated in place
+ * @param dt time step the extrapolated velocities are advected with
+ */
+void Simulator::extrapolateVelocity(State *state, float dt) {
+  GridCoordinate lower, upper;
+  if (!state->levelSet->getFluidBounds(lower, upper)) {
+    return;
+  }
+  if (state == stateFrom && !maxFaceVelocityKnown) {
+    maxFaceVelocity = maxVelocity(state->velocityGrid);
+    maxFaceVelocityKnown = true;
+  }
+  const glm::vec3 fastest = state == stateFrom ? maxFaceVelocity : maxVelocity(state->velocityGrid);
+  // clamped as a float, an infinite speed takes the largest depth and an undefined one the least
+  const float reach = std::ceil(glm::length(fastest)*dt) + 1.0f;
+  const unsigned int depth = (unsigned int)std::min(std::max((float)extrapolationDepth, reach), (float)MAX_EXTRAPOLATION_DEPTH);
+
+  const Grid<CellType> *cellTypeGrid = state->getCellTypeGrid();
+  extrapolateVelocityComponent(state->velocityGrid->u, cellTypeGrid, GridCoordinate(1, 0, 0), lower, upper, depth);
+  extrapolateVelocityComponent(state->velocityGrid->v, cellTypeGrid, GridCoordinate(0, 1, 0), lower, upper, depth);
+  extrapolateVelocityComponent(state->velocityGrid->w, cellTypeGrid, GridCoordinate(0, 0, 1), lower, upper, depth);
+}
 
-          if (nContributions > 0) {
-            velocityGrid->u->set(i, j, k, u/(float)nContributions);
-          } else {
-            velocityGrid->u->set(i, j, k, 0.0);
-          }
+/**
+ * Breadth first search over the faces of one velocity component, normal to axis.
+ * Faces with a FLUID cell on either side are layer 0. Layer n are the faces between
+ * two EMPTY cells next to a face of layer n - 1, and take the average of their
+ * neighbours from earlier layers. The faces of a layer only read earlier layers,
+ * so they are updated in parallel. The search ends after depth layers and stays
+ * within the fluid bounds grown by one face more than the depth.
+ */
+void Simulator::extrapolateVelocityComponent(OrdinalGrid<float> *velocities, Grid<CellType> const* cellTypeGrid,
+                                             GridCoordinate axis, GridCoordinate lower, GridCoordinate upper,
+                                             unsigned int depth) {
+  const int fw = velocities->getW();
+  const int fh = velocities->getH();
+  const int fd = velocities->getD();
+  const int margin = depth + 1;
+  const FaceBox box = {
+    glm::max(lower - GridCoordinate(margin), GridCoordinate(0)),
+    glm::min(upper + axis + GridCoordinate(margin), GridCoordinate(fw - 1, fh - 1, fd - 1)),
+    fw, fh
+  };
+  const GridCoordinate &boxLower = box.lower;
+  const GridCoordinate &boxUpper = box.upper;
+  extrapolationLayers.resize(fw*fh*fd);
+
+  auto index = [&](int i, int j, int k) {
+    return (k*fh + j)*fw + i;
+  };
+
+  // faces next to fluid are layer 0, faces between two EMPTY cells are unknown
+  // and the rest, next to solids, keep their velocity and are not extrapolated from
+#pragma omp parallel for collapse(2)
+  for (int k = boxLower.z; k <= boxUpper.z; k++) {
+    for (int j = boxLower.y; j <= boxUpper.y; j++) {
+      for (int i = boxLower.x; i <= boxUpper.x; i++) {
+        const CellType before = cellTypeGrid->clampGet(i - axis.x, j - axis.y, k - axis.z);
+        const CellType after = cellTypeGrid->clampGet(i, j, k);
+        uint8_t layer = FIXED_FACE;
+        if (before == CellType::FLUID || after == CellType::FLUID) {
+          layer = 0;
+        } else if (before == CellType::EMPTY && after == CellType::EMPTY) {
+          layer = UNKNOWN_FACE;
         }
+        extrapolationLayers[index(i, j, k)] = layer;
       }
     }
   }
 
-  // v velocities
-  for (unsigned k = 0; k < d; ++k) {
-    for (unsigned j = 0; j <= h; ++j) {
-      for (unsigned i = 0; i < w; ++i) {
-        GridCoordinate upCell = GridCoordinate(i, j - 1, k);
-        GridCoordinate downCell = GridCoordinate(i, j, k);
-
-        if (cellTypeGrid->clampGet(upCell) == CellType::EMPTY &&
-            cellTypeGrid->clampGet(downCell) == CellType::EMPTY) {
-
-          GridCoordinate farUp = GridCoordinate(i, j - 2, k);
-          GridCoordinate leftUp = GridCoordinate(i - 1, j - 1, k);
-          GridCoordinate rightUp = GridCoordinate(i + 1, j - 1, k);
-          GridCoordinate frontUp = GridCoordinate(i, j - 1, k - 1);
-          GridCoordinate backUp = GridCoordinate(i, j - 1, k + 1);
-
-          GridCoordinate farDown = GridCoordinate(i, j + 1, k);
-          GridCoordinate leftDown = GridCoordinate(i - 1 , j, k);
-          GridCoordinate rightDown = GridCoordinate(i + 1, j, k);
-          GridCoordinate frontDown = GridCoordinate(i, j, k - 1);
-          GridCoordinate backDown = GridCoordinate(i, j, k + 1);
-
-          float v = 0;
-          unsigned int nContributions = 0;
-
-          // up cells
-          if (cellTypeGrid->clampGet(farUp) == CellType::FLUID) {
-            v += velocityGrid->v->get(i, j - 1, k);
-            ++nContributions;
-          }
-
-          // down cells
-          if (cellTypeGrid->clampGet(farDown) == CellType::FLUID) {
-            v += velocityGrid->v->get(i, j + 1, k);
-            ++nContributions;
-          }
-
-          // left cells
-          if (cellTypeGrid->clampGet(leftUp) == CellType::FLUID ||
-              cellTypeGrid->clampGet(leftDown) == CellType::FLUID) {
-            v += velocityGrid->v->get(i - 1, j, k);
-            ++nContributions;
-          }
-
-          // right cells
-          if (cellTypeGrid->clampGet(rightUp) == CellType::FLUID ||
-              cellTypeGrid->clampGet(rightDown) == CellType::FLUID) {
-            v += velocityGrid->v->get(i + 1, j, k);
-            ++nContributions;
-          }
-
-          //front cells
-          if (cellTypeGrid->clampGet(frontUp) == CellType::FLUID ||
-              cellTypeGrid->clampGet(frontDown) == CellType::FLUID) {
-            v += velocityGrid->v->get(i, j, k - 1);
-            ++nContributions;
+  extrapolationFrontier.clear();
+#pragma omp parallel
+  {
+    std::vector<int> found;
+#pragma omp for collapse(2) nowait
+    for (int k = boxLower.z; k <= boxUpper.z; k++) {
+      for (int j = boxLower.y; j <= boxUpper.y; j++) {
+        for (int i = boxLower.x; i <= boxUpper.x; i++) {
+          const int n = index(i, j, k);
+          if (extrapolationLayers[n] != UNKNOWN_FACE) {
+            continue;
           }
-
-          //back cells
-          if (cellTypeGrid->clampGet(backUp) == CellType::FLUID ||
-              cellTypeGrid->clampGet(backDown) == CellType::FLUID) {
-            v += velocityGrid->v->get(i, j, k + 1);
-            ++nContributions;
-          }
-
-          if (nContributions > 0) {
-            velocityGrid->v->set(i, j, k, v/(float)nContributions);
-          } else {
-            velocityGrid->v->set(i, j, k, 0.0);
+          bool nextToFluid = false;
+          box.forEachNeighbor(n, [&](int m) {
+              nextToFluid = nextToFluid || extrapolationLayers[m] == 0;
+            });
+          if (nextToFluid) {
+            found.push_back(n);
           }
         }
       }
     }
+#pragma omp critical
+    extrapolationFrontier.insert(extrapolationFrontier.end(), found.begin(), found.end());
   }
 
-  // w velocities
-  for (unsigned k = 0; k <= d; ++k) {
-    for (unsigned j = 0; j < h; ++j) {
-      for (unsigned i = 0; i < w; ++i) {
-        GridCoordinate frontCell = GridCoordinate(i, j, k - 1);
-        GridCoordinate backCell = GridCoordinate(i, j, k);
-
-        if (cellTypeGrid->clampGet(frontCell) == CellType::EMPTY &&
-            cellTypeGrid->clampGet(backCell) == CellType::EMPTY) {
-
-          GridCoordinate farFront = GridCoordinate(i, j, k - 2);
-
-          GridCoordinate leftFront = GridCoordinate(i - 1, j, k - 1);
-          GridCoordinate rightFront = GridCoordinate(i + 1, j, k - 1);
-          GridCoordinate upFront = GridCoordinate(i, j - 1, k - 1);
-          GridCoordinate downFront = GridCoordinate(i, j + 1, k - 1);
-
-          GridCoordinate farBack = GridCoordinate(i, j, k + 1);
-
-          GridCoordinate leftBack = GridCoordinate(i - 1, j, k);
-          GridCoordinate rightBack = GridCoordinate(i + 1, j, k);
-          GridCoordinate upBack = GridCoordinate(i, j - 1, k);
-          GridCoordinate downBack = GridCoordinate(i, j + 1, k);
-
-          float velocity = 0;
-          unsigned int nContributions = 0;
-
-          // front cell
-          if (cellTypeGrid->clampGet(farFront) == CellType::FLUID) {
-            velocity += velocityGrid->w->get(i, j, k - 1);
-            ++nContributions;
-          }
-
-          // back cell
-          if (cellTypeGrid->clampGet(farBack) == CellType::FLUID) {
-            velocity += velocityGrid->w->get(i, j, k + 1);
-            ++nContributions;
-          }
-
-          // left cells
-          if (cellTypeGrid->clampGet(leftFront) == CellType::FLUID ||
-              cellTypeGrid->clampGet(leftBack) == CellType::FLUID) {
-            velocity += velocityGrid->w->get(i - 1, j, k);
-            ++nContributions;
-          }
-
-          // right cells
-          if (cellTypeGrid->clampGet(rightFront) == CellType::FLUID ||
-              cellTypeGrid->clampGet(rightBack) == CellType::FLUID) {
-            velocity += velocityGrid->w->get(i + 1, j, k);
-            ++nContributions;
-          }
-
-          // up cells
-          if (cellTypeGrid->clampGet(upFront) == CellType::FLUID ||
-              cellTypeGrid->clampGet(upBack) == CellType::FLUID) {
-            velocity += velocityGrid->w->get(i, j - 1, k);
-            ++nContributions;
-          }
+  std::vector<int> next;
+  std::vector<float> values;
+  for (unsigned int layer = 1; layer <= depth && !extrapolationFrontier.empty(); layer++) {
+    const int count = extrapolationFrontier.size();
+#pragma omp parallel for
+    for (int f = 0; f < count; f++) {
+      extrapolationLayers[extrapolationFrontier[f]] = layer;
+    }
 
-          // down cells
-          if (cellTypeGrid->clampGet(downFront) == CellType::FLUID ||
-              cellTypeGrid->clampGet(downBack) == CellType::FLUID) {
-            velocity += velocityGrid->w->get(i, j + 1, k);
-            ++nContributions;
+    values.resize(count);
+#pragma omp parallel for
+    for (int f = 0; f < count; f++) {
+      float sum = 0.0f;
+      int contributions = 0;
+      box.forEachNeighbor(extrapolationFrontier[f], [&](int m) {
+          if (extrapolationLayers[m] < layer) {
+            sum += velocities->get(m % fw, (m/fw) % fh, m/(fw*fh));
+            contributions++;
           }
+        });
+      values[f] = contributions > 0 ? sum/contributions : 0.0f;
+    }
+#pragma omp parallel for
+    for (int f = 0; f < count; f++) {
+      const int n = extrapolationFrontier[f];
+      velocities->set(n % fw, (n/fw) % fh, n/(fw*fh), values[f]);
+    }
 
-          if (nContributions > 0) {
-            velocityGrid->w->set(i, j, k, velocity/(float)nContributions);
-          } else {
-            velocityGrid->w->set(i, j, k, 0.0);
-          }
-        }
+    if (layer == depth) {
+      break;
+    }
+    next.clear();
+#pragma omp parallel
+    {
+      std::vector<int> found;
+#pragma omp for nowait
+      for (int f = 0; f < count; f++) {
+        box.forEachNeighbor(extrapolationFrontier[f], [&](int m) {
+            if (extrapolationLayers[m] == UNKNOWN_FACE) {
+              found.push_back(m);
+            }
+          });
       }
+#pragma omp critical
+      next.insert(next.end(), found.begin(), found.end());
     }
+    // faces reached from several faces of the layer are only taken once
+    std::sort(next.begin(), next.end());
+    next.erase(std::unique(next.begin(), next.end()), next.end());
+    std::swap(extrapolationFrontier, next);
   }
 }
 
-/**
- * Method to extrapolate velocity values from the water region to the air/empty region.
- * @param stateFrom
- * @param stateTo
- */
-void Simulator::extrapolateVelocity(State *stateFrom, State *stateTo) {
-  initializeExtrapolation(stateFrom);
-  const Grid<glm::vec3> *closestPointGrid = stateFrom->levelSet->getClosestPointGrid();
-
-  VelocityGrid *fromVelocityGrid = stateFrom->velocityGrid;
-  VelocityGrid *toVelocityGrid = stateTo->velocityGrid;
-  const Grid<CellType> *cellTypeGrid = stateFrom->getCellTypeGrid();
-
-  unsigned int w = stateFrom->w;
-  unsigned int h = stateFrom->h;
-  unsigned int d = stateFrom->d;
-
-  // u velocities
-  toVelocityGrid->u->setForEach([&](unsigned i, unsigned j, unsigned k) {
-      glm::vec3 currentPoint = glm::vec3(i - 0.5, j, k);
-      GridCoordinate leftCell = GridCoordinate(i - 1, j, k);
-      GridCoordinate rightCell = GridCoordinate(i, j, k);
-
-      if (cellTypeGrid->clampGet(leftCell) != CellType::EMPTY ||
-          cellTypeGrid->clampGet(rightCell) != CellType::EMPTY) {
-        return fromVelocityGrid->u->get(i, j, k);
-      }
-
-      glm::vec3 leftClosestPoint = closestPointGrid->clampGet(leftCell);
-      glm::vec3 rightClosestPoint = closestPointGrid->clampGet(rightCell);
-
-      float dLeft = glm::distance(currentPoint, leftClosestPoint);
-      float dRight = glm::distance(currentPoint, rightClosestPoint);
-
-      float uLeft = fromVelocityGrid->u->getLerp(leftClosestPoint.x + 0.5, leftClosestPoint.y, leftClosestPoint.z);
-      float uRight = fromVelocityGrid->u->getLerp(rightClosestPoint.x + 0.5, rightClosestPoint.y, rightClosestPoint.z);
-
-      float t = dLeft/(dLeft + dRight);
-      return t*uRight + (1.0f - t)*uLeft;
-    });
-
-  // v velocities
-  toVelocityGrid->v->setForEach([&](unsigned i, unsigned j, unsigned k) {
-      glm::vec3 currentPoint = glm::vec3(i, j - 0.5, k);
-      GridCoordinate upCell = GridCoordinate(i, j - 1, k);
-      GridCoordinate downCell = GridCoordinate(i, j, k);
-
-      if (cellTypeGrid->clampGet(upCell) != CellType::EMPTY ||
-          cellTypeGrid->clampGet(downCell) != CellType::EMPTY) {
-        return fromVelocityGrid->v->get(i, j, k);
-      }
+void Simulator::setExtrapolationDepth(unsigned int layers) {
+  extrapolationDepth = std::min(layers, (unsigned int)MAX_EXTRAPOLATION_DEPTH);
+}
 
-      glm::vec3 upClosestPoint = closestPointGrid->clampGet(upCell);
-      glm::vec3 downClosestPoint = closestPointGrid->clampGet(downCell);
+unsigned int Simulator::getExtrapolationDepth() const {
+  return extrapolationDepth;
+}
 
-      float dUp = glm::distance(currentPoint, upClosestPoint);
-      float dDown = glm::distance(currentPoint, downClosestPoint);
+/**
+ * Find the cells this step can change: the fluid of state, grown by the distance
+ * its fastest cell travels in dt and a padding for the interpolation stencils.
+ * All of the domain if the region is not used, or without the particle level set,
+ * which is the only thing that reinitializes the distances the region leaves stale.
+ * @param state state the step starts from
+ * @param dt time step length
+ */
+void Simulator::updateActiveRegion(State const* state, float dt) {
+  const GridCoordinate domainUpper(w - 1, h - 1, d - 1);
+  GridCoordinate lower, upper;
+  if (!restrictToActiveRegion || !usePls) {
+    activeLower = GridCoordinate(0);
+    activeUpper = domainUpper;
+  } else if (!state->levelSet->getFluidBounds(lower, upper)) {
+    activeLower = GridCoordinate(0);
+    activeUpper = GridCoordinate(-1);
+  } else {
+    // the projection that ended the last step found the fastest fluid faces,
+    // otherwise they are measured over the fluid and its faces
+    if (!maxFaceVelocityKnown) {
+      activeLower = glm::max(lower - GridCoordinate(1), GridCoordinate(0));
+      activeUpper = glm::min(upper + GridCoordinate(1), domainUpper);
+      maxFaceVelocity = maxVelocity(state->velocityGrid);
+      maxFaceVelocityKnown = true;
+    }
+    const float travel = glm::length(maxFaceVelocity)*dt;
+    const int margin = (int)std::ceil(travel) + ACTIVE_REGION_PADDING;
+    activeLower = glm::max(lower - GridCoordinate(margin), GridCoordinate(0));
+    activeUpper = glm::min(upper + GridCoordinate(margin), domainUpper);
+  }
 
-      float vUp = fromVelocityGrid->v->getLerp(upClosestPoint.x, upClosestPoint.y + 0.5, upClosestPoint.z);
-      float vDown = fromVelocityGrid->v->getLerp(downClosestPoint.x, downClosestPoint.y + 0.5, downClosestPoint.z);
+  const GridCoordinate extent = glm::max(activeUpper - activeLower + GridCoordinate(1), GridCoordinate(0));
+  activeCells += (unsigned long long)extent.x*extent.y*extent.z;
+  domainCells += (unsigned long long)w*h*d;
+}
 
-      float t = dUp/(dUp + dDown);
-      return t*vDown + (1.0f - t)*vUp;
-    });
+void Simulator::setRestrictToActiveRegion(bool enabled) {
+  restrictToActiveRegion = enabled;
+}
 
-  // w velocities
-  toVelocityGrid->w->setForEach([&](unsigned i, unsigned j, unsigned k) {
-      glm::vec3 currentPoint = glm::vec3(i, j, k - 0.5);
-      GridCoordinate frontCell = GridCoordinate(i, j, k - 1);
-      GridCoordinate backCell = GridCoordinate(i, j, k);
+bool Simulator::getRestrictToActiveRegion() const {
+  return restrictToActiveRegion;
+}
 
-      if (cellTypeGrid->clampGet(frontCell) != CellType::EMPTY ||
-          cellTypeGrid->clampGet(backCell) != CellType::EMPTY) {
-        return fromVelocityGrid->w->get(i, j, k);
-      }
+void Simulator::getActiveRegion(GridCoordinate &lower, GridCoordinate &upper) const {
+  lower = activeLower;
+  upper = activeUpper;
+}
 
-      glm::vec3 frontClosestPoint = closestPointGrid->clampGet(frontCell);
-      glm::vec3 backClosestPoint = closestPointGrid->clampGet(backCell);
+float Simulator::getSkippedFraction() const {
+  if (domainCells == 0) {
+    return 0.0f;
+  }
+  return 1.0f - (float)((double)activeCells/domainCells);
+}
 
-      float dFront = glm::distance(currentPoint, frontClosestPoint);
-      float dBack = glm::distance(currentPoint, backClosestPoint);
+void Simulator::setDistanceAdvectionBand(float width) {
+  // a band of at least a cell keeps the overshoot of Catmull-Rom from flipping signs
+  distanceAdvectionBand = std::max(MIN_DISTANCE_ADVECTION_BAND, width);
+}
 
-      float wFront = fromVelocityGrid->w->getLerp(frontClosestPoint.x, frontClosestPoint.y, frontClosestPoint.z + 0.5);
-      float wBack = fromVelocityGrid->w->getLerp(backClosestPoint.x, backClosestPoint.y, backClosestPoint.z + 0.5);
+float Simulator::getDistanceAdvectionBand() const {
+  return distanceAdvectionBand;
+}
 
-      float t = dFront/(dFront + dBack);
-      return t*wBack + (1.0f - t)*wFront;
-    });
-  // std::cin.get();
+void Simulator::setUseVelocityCache(bool enabled) {
+  if (enabled && !velocityCache) {
+    velocityCache = new VelocityCache(w, h, d);
+  } else if (!enabled) {
+    delete velocityCache;
+    velocityCache = nullptr;
+  }
 }
 
+bool Simulator::getUseVelocityCache() const {
+  return velocityCache != nullptr;
+}
 
 /**
  * Reset pressure grid
  */
 OrdinalGrid<double>* Simulator::resetPressureGrid() {
-  for (unsigned k = 0; k < d; ++k) {
-    for (unsigned j = 0; j < h; ++j) {
-      for (unsigned i = 0; i < w; ++i) {
-        pressureGridFrom->set(i, j, k, 0.0);
-        pressureGridTo->set(i, j, k, 0.0);
-      }
-    }
-  }
+  auto zero = [&](unsigned int j, unsigned int k, double *row) {
+    std::fill(row, row + w, 0.0);
+  };
+  pressureGridFrom->setForEachRow(zero);
+  pressureGridTo->setForEachRow(zero);
   return pressureGridFrom;
 }
 
 
 /**
- * Find the maximum velocity present in the grid
+ * Find the largest face speed along each axis in the active region of the grid.
+ * The projection finds them for the fluid faces as it goes, this is for velocities
+ * that did not come from a projection.
  * @param  velocity velocity grid to sample from
- * @return maxVec   max velocity vector
+ * @return maxVec   largest absolute u, v and w
  */
 glm::vec3 Simulator::maxVelocity(VelocityGrid const *const velocity){
 
-  glm::vec3 maxVec = velocity->getCell(0, 0, 0);
-
-  //  std::cout << maxVec.x << ", " << maxVec.y << " " << maxVec.z << std::endl;
-
-  for (unsigned k = 0; k < d; ++k) {
-    for (unsigned j = 0; j < h; j++) {
-      for (unsigned i = 0; i < w; i++) {
-        if (glm::length(maxVec) < glm::length(velocity->getCell(i, j, k))) {
-          maxVec = velocity->getCell(i, j, k);
-        }
-      }
-    }
-  }
-  return maxVec;
+  // the divergence grid is only used for its w*h*d cell extent
+  return divergenceGrid->reduceInBox(activeLower, activeUpper, glm::vec3(0.0f),
+    [&](unsigned int i, unsigned int j, unsigned int k) {
+      const glm::vec3 before(velocity->u->get(i, j, k), velocity->v->get(i, j, k), velocity->w->get(i, j, k));
+      const glm::vec3 after(velocity->u->get(i + 1, j, k), velocity->v->get(i, j + 1, k), velocity->w->get(i, j, k + 1));
+      return glm::max(glm::abs(before), glm::abs(after));
+    },
+    [](glm::vec3 a, glm::vec3 b) {
+      return glm::max(a, b);
+    });
 }
 
 
@@ -0,0 +1,49 @@
+#include <solidFaces.h>
+
+constexpr uint8_t SolidFaces::LEFT;
+constexpr uint8_t SolidFaces::RIGHT;
+constexpr uint8_t SolidFaces::UP;
+constexpr uint8_t SolidFaces::DOWN;
+constexpr uint8_t SolidFaces::FRONT;
+constexpr uint8_t SolidFaces::BACK;
+constexpr uint8_t SolidFaces::ALL_FACES;
+constexpr uint8_t SolidFaces::SOLID_CELL;
+
+SolidFaces::SolidFaces(unsigned int w, unsigned int h, unsigned int d){
+  masks = new Grid<uint8_t>(w, h, d);
+  masks->setForEach([](unsigned int, unsigned int, unsigned int) {
+      return (uint8_t)0;
+    });
+}
+
+SolidFaces::SolidFaces(const SolidFaces& origin){
+  masks = new Grid<uint8_t>(*origin.masks);
+}
+
+SolidFaces::~SolidFaces(){
+  delete masks;
+}
+
+void SolidFaces::build(Grid<CellType> const* const cellTypeGrid){
+  masks->setForEach([&](unsigned int i, unsigned int j, unsigned int k) {
+      return maskAt(cellTypeGrid, i, j, k);
+    });
+}
+
+uint8_t SolidFaces::maskAt(Grid<CellType> const* const cellTypeGrid, int i, int j, int k){
+  auto isSolid = [&](int i, int j, int k) {
+    return cellTypeGrid->isValid(i, j, k) && cellTypeGrid->get(i, j, k) == CellType::SOLID;
+  };
+  return (isSolid(i - 1, j, k) ? LEFT : 0) | (isSolid(i + 1, j, k) ? RIGHT : 0) |
+    (isSolid(i, j - 1, k) ? UP : 0) | (isSolid(i, j + 1, k) ? DOWN : 0) |
+    (isSolid(i, j, k - 1) ? FRONT : 0) | (isSolid(i, j, k + 1) ? BACK : 0) |
+    (isSolid(i, j, k) ? SOLID_CELL : 0);
+}
+
+int SolidFaces::openFaces(uint8_t mask){
+  int closed = 0;
+  for (uint8_t faces = mask & ALL_FACES; faces != 0; faces &= faces - 1) {
+    closed++;
+  }
+  return 6 - closed;
+}
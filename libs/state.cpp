@@ -3,6 +3,7 @@
 #include <ordinalGrid.h>
 #include <iostream>
 #include <levelSet.h>
+#include <solidFaces.h>
 #include <bubble.h>
 
 /**
@@ -12,6 +13,7 @@ State::State(unsigned int width, unsigned int height, unsigned int depth) :
   w(width), h(height), d(depth) {
   velocityGrid = new VelocityGrid(w, h, d);
   levelSet = new LevelSet(w, h, d);
+  solidFaces = new SolidFaces(w, h, d);
   resetVelocityGrids();
   frameNumber = 0;
   bubbles = std::vector<Bubble>();
@@ -26,6 +28,7 @@ State::State(const State& origin) {
 
   velocityGrid = new VelocityGrid(*origin.velocityGrid);
   levelSet = new LevelSet(*origin.levelSet);
+  solidFaces = new SolidFaces(*origin.solidFaces);
   bubbles = origin.bubbles;
   deadBubbleIndices = origin.deadBubbleIndices;
   nextBubbleId = origin.nextBubbleId;
@@ -37,6 +40,7 @@ State::State(const State& origin) {
 State::~State() {
   delete velocityGrid;
   delete levelSet;
+  delete solidFaces;
 }
 
 /**
@@ -128,6 +132,11 @@ unsigned int State::getD() const {
  */
 void State::setCellTypeGrid(Grid<CellType>const* const ctg) {
   levelSet->setCellTypeGrid(ctg);
+  updateSolidFaces();
+}
+
+void State::updateSolidFaces() {
+  solidFaces->build(levelSet->getCellTypeGrid());
 }
 
 /**
@@ -155,6 +164,9 @@ void State::setLevelSet(LevelSet *ls) {
   levelSet->distanceGrid->setForEach([=](const unsigned int &i, const unsigned int &j, const unsigned int &k) {
       return ls->distanceGrid->get(i, j, k);
     });
+  // the cell types and fluid bounds follow the copied distances, not initSDF
+  levelSet->updateCellTypes();
+  updateSolidFaces();
 };
 
 /**
@@ -182,6 +194,22 @@ Grid<glm::vec3> const *const State::getClosestPointGrid() const {
   return levelSet->getClosestPointGrid();
 }
 
+/**
+ * Get the solid faces of every cell
+ * @return const pointer to the solid face masks.
+ */
+SolidFaces const *State::getSolidFaces() const {
+  return solidFaces;
+}
+
+/**
+ * Get the box around the fluid cells, inclusive.
+ * @return false if there is no fluid.
+ */
+bool State::getFluidBounds(GridCoordinate &lower, GridCoordinate &upper) const {
+  return levelSet->getFluidBounds(lower, upper);
+}
+
 /**
  * Get bubbles
  */
@@ -275,6 +303,9 @@ std::istream& State::read(std::istream& stream){
   delete levelSet;
   levelSet = new LevelSet(w,h,d);
   levelSet->read(stream);
+  delete solidFaces;
+  solidFaces = new SolidFaces(w, h, d);
+  updateSolidFaces();
 
   //Read bubbles from stream
   int nBubbles;
@@ -0,0 +1,163 @@
+#include <stencilPCGSolver.h>
+#include <micPreconditioner.h>
+#include <ordinalGrid.h>
+#include <state.h>
+#include <cmath>
+#include <algorithm>
+#include <iostream>
+
+StencilPCGSolver::StencilPCGSolver(Preconditioner *preconditioner, double tolerance, int maxIterations){
+  this->preconditioner = preconditioner ? preconditioner : new MICPreconditioner();
+  this->tolerance = tolerance;
+  this->maxIterations = maxIterations;
+  iterations = 0;
+  warmStart = false;
+}
+
+StencilPCGSolver::~StencilPCGSolver(){
+  delete preconditioner;
+}
+
+/**
+ * Replace the preconditioner, the solver takes ownership of it.
+ */
+void StencilPCGSolver::setPreconditioner(Preconditioner *preconditioner){
+  delete this->preconditioner;
+  this->preconditioner = preconditioner;
+}
+
+void StencilPCGSolver::setWarmStart(bool warmStart){
+  this->warmStart = warmStart;
+}
+
+bool StencilPCGSolver::solve(OrdinalGrid<float> const* const divergenceGrid, State const* const state, OrdinalGrid<double> *pressureGrid, const float dt){
+  if (warmStart) {
+    previousFluidCells = stencil.fluidCells;
+  }
+  stencil.build(state, dt);
+
+  const int size = stencil.size();
+  stencil.fluidCells.gather(divergenceGrid, residual);
+  z.resize(size);
+  // converge to the same tolerance as a cold start, relative to the right hand side
+  const double tol = tolerance*absMax(residual);
+  if (warmStart) {
+    warmStartPressure(pressureGrid);
+    stencil.apply(pressure, z);
+    addScaled(-1.0, z, residual);
+  } else {
+    pressure.assign(size, 0.0);
+  }
+
+  bool solved = true;
+  double residualNorm = absMax(residual);
+  iterations = 0;
+  if (residualNorm > tol) {
+    preconditioner->build(state, &stencil);
+    preconditioner->apply(residual, z);
+    double rho = dot(z, residual);
+    search = z;
+
+    solved = false;
+    while (rho != 0 && iterations < maxIterations) {
+      stencil.apply(search, z);
+      const double alpha = rho/dot(search, z);
+      addScaled(alpha, search, pressure);
+      addScaled(-alpha, z, residual);
+      iterations++;
+
+      residualNorm = absMax(residual);
+      if (residualNorm <= tol) {
+        solved = true;
+        break;
+      }
+
+      preconditioner->apply(residual, z);
+      const double rhoNew = dot(z, residual);
+      const double beta = rhoNew/rho;
+      // search = z + beta*search
+      #pragma omp parallel for
+      for (int n = 0; n < size; n++) {
+        search[n] = z[n] + beta*search[n];
+      }
+      rho = rhoNew;
+    }
+  }
+
+  if (!solved) {
+    std::cerr << "Pressure Solver status: Failed with " << iterations << " iterations and "
+              << residualNorm << " as a residual" << std::endl;
+  }
+
+  stencil.fluidCells.scatter(pressure, pressureGrid);
+  return solved;
+}
+
+/**
+ * Initial guess from the pressure grid. Cells that were fluid in the previous
+ * solve keep their pressure, new fluid cells take the average of their previously
+ * fluid neighbours, or zero, the free surface pressure, if there are none.
+ */
+void StencilPCGSolver::warmStartPressure(OrdinalGrid<double> const* const pressureGrid){
+  const int size = stencil.size();
+  pressure.resize(size);
+  #pragma omp parallel for
+  for (int n = 0; n < size; n++) {
+    const GridCoordinate c = stencil.fluidCells.getCell(n);
+    const int i = c.x, j = c.y, k = c.z;
+    if (previousFluidCells.get(i, j, k) != FluidCellIndex::NOT_FLUID) {
+      pressure[n] = pressureGrid->get(i, j, k);
+      continue;
+    }
+    const GridCoordinate neighbours[] = {
+      GridCoordinate(i - 1, j, k), GridCoordinate(i + 1, j, k),
+      GridCoordinate(i, j - 1, k), GridCoordinate(i, j + 1, k),
+      GridCoordinate(i, j, k - 1), GridCoordinate(i, j, k + 1)
+    };
+    double sum = 0.0;
+    int count = 0;
+    for (const GridCoordinate &neighbour : neighbours) {
+      if (previousFluidCells.get(neighbour.x, neighbour.y, neighbour.z) != FluidCellIndex::NOT_FLUID) {
+        sum += pressureGrid->get(neighbour);
+        count++;
+      }
+    }
+    pressure[n] = count > 0 ? sum/count : 0.0;
+  }
+}
+
+int StencilPCGSolver::getIterations() const{
+  return iterations;
+}
+
+const PressureStencil& StencilPCGSolver::getStencil() const{
+  return stencil;
+}
+
+double StencilPCGSolver::dot(const std::vector<double> &a, const std::vector<double> &b) const{
+  const int size = a.size();
+  double sum = 0.0;
+  #pragma omp parallel for reduction(+:sum)
+  for (int n = 0; n < size; n++) {
+    sum += a[n]*b[n];
+  }
+  return sum;
+}
+
+double StencilPCGSolver::absMax(const std::vector<double> &a) const{
+  const int size = a.size();
+  double result = 0.0;
+  #pragma omp parallel for reduction(max:result)
+  for (int n = 0; n < size; n++) {
+    result = std::max(result, std::fabs(a[n]));
+  }
+  return result;
+}
+
+void StencilPCGSolver::addScaled(double alpha, const std::vector<double> &x, std::vector<double> &y) const{
+  const int size = x.size();
+  #pragma omp parallel for
+  for (int n = 0; n < size; n++) {
+    y[n] += alpha*x[n];
+  }
+}
@@ -1,5 +1,7 @@
 #include <util.h>
 #include <velocityGrid.h>
+#include <velocityCache.h>
+#include <vector>
 namespace {
 	inline glm::vec3 RK2BackTrack(
 		VelocityGrid const* const velocityGrid, 
@@ -61,6 +63,87 @@ namespace {
 
 		return position - ((dt*2/9)*k1 + (dt*3/9)*k2 + (dt*4/9)*k3);
 	}
+
+	/**
+	 * RK2BackTrack for a whole row of cells, sampling the velocities in batches.
+	 */
+	inline void RK2BackTrackRow(
+		VelocityGrid const* const velocityGrid,
+		int i0,
+		int j,
+		int k,
+		unsigned int count,
+		float dt,
+		glm::vec3 dispU,
+		glm::vec3 dispV,
+		glm::vec3 dispW,
+		glm::vec3 *positions){
+
+		std::vector<glm::vec3> v(count);
+		for (unsigned int i = 0; i < count; i++) {
+			positions[i] = glm::vec3(i0 + i, j, k);
+		}
+		velocityGrid->getLerp(positions, v.data(), count, dispU, dispV, dispW);
+
+		std::vector<glm::vec3> midPos(count);
+		for (unsigned int i = 0; i < count; i++) {
+			midPos[i] = positions[i] - (dt/2)*v[i];
+		}
+		velocityGrid->getLerp(midPos.data(), v.data(), count, dispU, dispV, dispW);
+
+		for (unsigned int i = 0; i < count; i++) {
+			positions[i] = positions[i] - dt*v[i];
+		}
+	}
+
+	/**
+	 * RK2BackTrack through cell-centred velocities. The cell coordinates of a
+	 * sample are its position plus offset, the position of index 0 of the grid.
+	 */
+	inline glm::vec3 RK2BackTrack(
+		VelocityCache const* velocityCache,
+		int i,
+		int j,
+		int k,
+		float dt,
+		glm::vec3 offset){
+
+		glm::vec3 position(i, j, k);
+		glm::vec3 v = velocityCache->sampleVelocity(position + offset);
+		glm::vec3 midPos = position - (dt/2)*v;
+		glm::vec3 midV = velocityCache->sampleVelocity(midPos + offset);
+		return position - dt*midV;
+	}
+
+	/**
+	 * RK2BackTrack through cell-centred velocities for a whole row of cells.
+	 */
+	inline void RK2BackTrackRow(
+		VelocityCache const* velocityCache,
+		int i0,
+		int j,
+		int k,
+		unsigned int count,
+		float dt,
+		glm::vec3 offset,
+		glm::vec3 *positions){
+
+		std::vector<glm::vec3> samples(count);
+		std::vector<glm::vec3> v(count);
+		for (unsigned int i = 0; i < count; i++) {
+			samples[i] = glm::vec3(i0 + i, j, k) + offset;
+		}
+		velocityCache->sampleVelocity(samples.data(), v.data(), count);
+
+		for (unsigned int i = 0; i < count; i++) {
+			samples[i] = samples[i] - (dt/2)*v[i];
+		}
+		velocityCache->sampleVelocity(samples.data(), v.data(), count);
+
+		for (unsigned int i = 0; i < count; i++) {
+			positions[i] = glm::vec3(i0 + i, j, k) - dt*v[i];
+		}
+	}
 }
 
 
@@ -109,5 +192,78 @@ namespace util {
 			);
 		}
 
+		namespace mac{
+			void backTrackRowU(VelocityGrid const* const velocityGrid, int i, int j, int k, unsigned int count, float dt, glm::vec3 *positions){
+				RK2BackTrackRow(velocityGrid, i, j, k, count, dt,
+					glm::vec3(0.0f),
+					glm::vec3(-0.5f, 0.5f, 0.0f),
+					glm::vec3(-0.5f, 0.0f, 0.5f),
+					positions
+				);
+			}
+
+			void backTrackRowV(VelocityGrid const* const velocityGrid, int i, int j, int k, unsigned int count, float dt, glm::vec3 *positions){
+				RK2BackTrackRow(velocityGrid, i, j, k, count, dt,
+					glm::vec3(0.5f, -0.5f, 0.0f),
+					glm::vec3(0.0f),
+					glm::vec3(0.0f, -0.5f, 0.5f),
+					positions
+				);
+			}
+
+			void backTrackRowW(VelocityGrid const* const velocityGrid, int i, int j, int k, unsigned int count, float dt, glm::vec3 *positions){
+				RK2BackTrackRow(velocityGrid, i, j, k, count, dt,
+					glm::vec3(0.5f, 0.0f, -0.5f),
+					glm::vec3(0.0f, 0.5f, -0.5f),
+					glm::vec3(0.0f),
+					positions
+				);
+			}
+		} // mac
+
+		void backTrackRow(VelocityGrid const* const velocityGrid, int i, int j, int k, unsigned int count, float dt, glm::vec3 *positions){
+			RK2BackTrackRow(velocityGrid, i, j, k, count, dt,
+				glm::vec3(0.5f, 0.0f, 0.0f),
+				glm::vec3(0.0f, 0.5f, 0.0f),
+				glm::vec3(0.0f, 0.0f, 0.5f),
+				positions
+			);
+		}
+
+		// faces of u, v and w lie half a cell before the centre of the cell with their index
+		namespace mac{
+			glm::vec3 backTrackU(VelocityCache const* velocityCache, int i, int j, int k, float dt){
+				return RK2BackTrack(velocityCache, i, j, k, dt, glm::vec3(-0.5f, 0.0f, 0.0f));
+			}
+
+			glm::vec3 backTrackV(VelocityCache const* velocityCache, int i, int j, int k, float dt){
+				return RK2BackTrack(velocityCache, i, j, k, dt, glm::vec3(0.0f, -0.5f, 0.0f));
+			}
+
+			glm::vec3 backTrackW(VelocityCache const* velocityCache, int i, int j, int k, float dt){
+				return RK2BackTrack(velocityCache, i, j, k, dt, glm::vec3(0.0f, 0.0f, -0.5f));
+			}
+
+			void backTrackRowU(VelocityCache const* velocityCache, int i, int j, int k, unsigned int count, float dt, glm::vec3 *positions){
+				RK2BackTrackRow(velocityCache, i, j, k, count, dt, glm::vec3(-0.5f, 0.0f, 0.0f), positions);
+			}
+
+			void backTrackRowV(VelocityCache const* velocityCache, int i, int j, int k, unsigned int count, float dt, glm::vec3 *positions){
+				RK2BackTrackRow(velocityCache, i, j, k, count, dt, glm::vec3(0.0f, -0.5f, 0.0f), positions);
+			}
+
+			void backTrackRowW(VelocityCache const* velocityCache, int i, int j, int k, unsigned int count, float dt, glm::vec3 *positions){
+				RK2BackTrackRow(velocityCache, i, j, k, count, dt, glm::vec3(0.0f, 0.0f, -0.5f), positions);
+			}
+		} // mac
+
+		glm::vec3 backTrack(VelocityCache const* velocityCache, int i, int j, int k, float dt){
+			return RK2BackTrack(velocityCache, i, j, k, dt, glm::vec3(0.0f));
+		}
+
+		void backTrackRow(VelocityCache const* velocityCache, int i, int j, int k, unsigned int count, float dt, glm::vec3 *positions){
+			RK2BackTrackRow(velocityCache, i, j, k, count, dt, glm::vec3(0.0f), positions);
+		}
+
 	} // advect
 } // util
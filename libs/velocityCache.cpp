@@ -0,0 +1,52 @@
+#include <velocityCache.h>
+#include <velocityGrid.h>
+#include <ordinalGrid.h>
+
+VelocityCache::VelocityCache(unsigned int w, unsigned int h, unsigned int d) : w(w), h(h), d(d) {
+  cellVelocities = new OrdinalGrid<glm::vec3>(w, h, d);
+  cellVelocities->setForEach([](unsigned int, unsigned int, unsigned int) {
+      return glm::vec3(0.0f);
+    });
+}
+
+VelocityCache::~VelocityCache() {
+  delete cellVelocities;
+}
+
+/**
+ * Average the face velocities of every cell.
+ */
+void VelocityCache::update(VelocityGrid const* velocities) {
+  update(velocities, GridCoordinate(0), GridCoordinate(w - 1, h - 1, d - 1));
+}
+
+/**
+ * Average the face velocities of the cells from lower to upper, inclusive.
+ * The other cells keep the velocities they were last updated with.
+ */
+void VelocityCache::update(VelocityGrid const* velocities, GridCoordinate lower, GridCoordinate upper) {
+  OrdinalGrid<float> const *u = velocities->u;
+  OrdinalGrid<float> const *v = velocities->v;
+  OrdinalGrid<float> const *w = velocities->w;
+  cellVelocities->setForEachRowInBox(lower, upper, [&](unsigned int j, unsigned int k, glm::vec3 *row) {
+      for (int i = glm::max(lower.x, 0); i <= glm::min(upper.x, (int)this->w - 1); i++) {
+        row[i] = 0.5f*glm::vec3(u->get(i, j, k) + u->get(i + 1, j, k),
+                                v->get(i, j, k) + v->get(i, j + 1, k),
+                                w->get(i, j, k) + w->get(i, j, k + 1));
+      }
+    });
+}
+
+/**
+ * Velocity at p, in cell coordinates as VelocityGrid::getLerp.
+ */
+glm::vec3 VelocityCache::sampleVelocity(glm::vec3 p) const {
+  return cellVelocities->getLerp(p);
+}
+
+/**
+ * Batched sampleVelocity, values[n] = sampleVelocity(positions[n]) for n < count.
+ */
+void VelocityCache::sampleVelocity(const glm::vec3 *positions, glm::vec3 *values, unsigned int count) const {
+  cellVelocities->getLerp(positions, values, count);
+}
@@ -1,5 +1,6 @@
 #include <ordinalGrid.h>
 #include <velocityGrid.h>
+#include <vector>
 
 
 VelocityGrid::VelocityGrid(unsigned int w, unsigned int h, unsigned int d){
@@ -36,6 +37,38 @@ glm::vec3 VelocityGrid::getLerp(glm::vec3 p) const{
   );
 }
 
+/**
+ * Batched getLerp, values[n] = getLerp(positions[n]) for n < count.
+ */
+void VelocityGrid::getLerp(const glm::vec3 *positions, glm::vec3 *values, unsigned int count) const{
+  getLerp(positions, values, count,
+          glm::vec3(0.5f, 0.0f, 0.0f),
+          glm::vec3(0.0f, 0.5f, 0.0f),
+          glm::vec3(0.0f, 0.0f, 0.5f));
+}
+
+/**
+ * Batched sampling with each component read at positions[n] + its displacement,
+ * as the MAC backtraces do.
+ */
+void VelocityGrid::getLerp(const glm::vec3 *positions, glm::vec3 *values, unsigned int count,
+                           glm::vec3 dispU, glm::vec3 dispV, glm::vec3 dispW) const{
+  std::vector<glm::vec3> displaced(count);
+  std::vector<float> component(count);
+  OrdinalGrid<float> const *components[] = {u, v, w};
+  glm::vec3 displacements[] = {dispU, dispV, dispW};
+
+  for (int c = 0; c < 3; c++) {
+    for (unsigned int n = 0; n < count; n++) {
+      displaced[n] = positions[n] + displacements[c];
+    }
+    components[c]->getLerp(displaced.data(), component.data(), count);
+    for (unsigned int n = 0; n < count; n++) {
+      values[n][c] = component[n];
+    }
+  }
+}
+
 std::ostream& VelocityGrid::write(std::ostream& stream){
   u->write(stream);
   v->write(stream);
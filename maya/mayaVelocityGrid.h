@@ -2,6 +2,7 @@
 #include <maya/MFnField.h>
 #include <maya/MPointArray.h>
 #include <maya/MVectorArray.h>
+#include <vector>
 
 class MayaVelocityGrid : public MFnField{
 public:
@@ -13,11 +14,17 @@ public:
   }
   MStatus getForceAtPoint(const MPointArray &point, const MVectorArray &velocity, const MDoubleArray &mass, MVectorArray &force, double deltaTime=1.0/24.0){
     MStatus status;
+    std::vector<glm::vec3> positions(point.length());
+    std::vector<glm::vec3> gridVelocities(point.length());
+    for(int i = 0; i < point.length(); i++){
+      positions[i] = glm::vec3(point[i][0], point[i][1], point[i][2]);
+    }
+    grid->getLerp(positions.data(), gridVelocities.data(), point.length());
+
     for(int i = 0; i < point.length(); i++){
-      glm::vec3 pPosition = glm::vec3(point[i][0], point[i][1], point[i][2]);
       glm::vec3 pVelocity = glm::vec3(velocity[i][0], velocity[i][1], velocity[i][2]);
 
-      glm::vec3 gridVelocity = grid->getLerp(pPosition);
+      glm::vec3 gridVelocity = gridVelocities[i];
 
       glm::vec3 resultingVelocity = (gridVelocity - pVelocity);
 
@@ -28,11 +35,17 @@ public:
   
   MStatus getForceAtPoint(const MVectorArray &point, const MVectorArray &velocity, const MDoubleArray &mass, MVectorArray &force, double deltaTime=1.0/24.0){
     MStatus status;
+    std::vector<glm::vec3> positions(point.length());
+    std::vector<glm::vec3> gridVelocities(point.length());
+    for(int i = 0; i < point.length(); i++){
+      positions[i] = glm::vec3(point[i][0], point[i][1], point[i][2]);
+    }
+    grid->getLerp(positions.data(), gridVelocities.data(), point.length());
+
     for(int i = 0; i < point.length(); i++){
-      glm::vec3 pPosition = glm::vec3(point[i][0], point[i][1], point[i][2]);
       glm::vec3 pVelocity = glm::vec3(velocity[i][0], velocity[i][1], velocity[i][2]);
 
-      glm::vec3 gridVelocity = grid->getLerp(pPosition);
+      glm::vec3 gridVelocity = gridVelocities[i];
 
       glm::vec3 resultingVelocity = (gridVelocity - pVelocity);
 
@@ -0,0 +1,762 @@
+// Include standard headers
+#include <stdio.h>
+#include <stdlib.h>
+
+// Timing
+#include <chrono>
+
+// Include GLM
+#include <glm/glm.hpp>
+
+// io
+#include <iostream>
+#include <string>
+#include <vector>
+#include <functional>
+#include <algorithm>
+#include <limits>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include <factories/levelSetFactories.h>
+#include <factories/preconditionerFactories.h>
+#include <grid.h>
+#include <ordinalGrid.h>
+#include <state.h>
+#include <simulator.h>
+#include <velocityGrid.h>
+#include <velocityCache.h>
+#include <util.h>
+#include <levelSet.h>
+#include <gridHeap.h>
+#include <gridBucketQueue.h>
+#include <micSolver.h>
+#include <stencilPCGSolver.h>
+#include <micPreconditioner.h>
+#include <multigridPreconditioner.h>
+
+namespace {
+
+  struct Benchmark {
+    std::string name;
+    std::string description;
+    std::function<void (unsigned int n, unsigned int steps)> run;
+  };
+
+  typedef std::chrono::steady_clock Clock;
+
+  double millisecondsSince(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+  }
+
+  /**
+   * Same scene as the headless executable: a ball dropped on stairs.
+   */
+  State* createInitialState(unsigned int n) {
+    State *state = new State(n, n, n);
+
+    LevelSet *ls = factory::levelSet::ball(n, n, n);
+    LevelSet *ls2 = factory::levelSet::stairs(n, n, n);
+    ls->merge(ls2);
+    state->setLevelSet(ls);
+
+    VelocityGrid *velocities = new VelocityGrid(n, n, n);
+    state->setVelocityGrid(velocities);
+
+    delete velocities;
+    delete ls2;
+    delete ls;
+    return state;
+  }
+
+  /**
+   * Average wall time of Simulator::step in milliseconds.
+   */
+  double timeSimulatorStep(unsigned int n, unsigned int steps) {
+    State *initialState = createInitialState(n);
+    Simulator sim(*initialState, 0.1f);
+    delete initialState;
+
+    // warm up, the first step touches every page of every grid
+    sim.step(0.1f);
+
+    Clock::time_point start = Clock::now();
+    for (unsigned int i = 0; i < steps; ++i) {
+      sim.step(0.1f);
+    }
+    return millisecondsSince(start) / steps;
+  }
+
+  void gridLayout(unsigned int n, unsigned int steps) {
+    GridLayout previous = defaultGridLayout();
+
+    defaultGridLayout() = GridLayout::FLAT;
+    double flat = timeSimulatorStep(n, steps);
+    std::cout << "  flat:    " << flat << " ms/step" << std::endl;
+
+    defaultGridLayout() = GridLayout::BRICKED;
+    double bricked = timeSimulatorStep(n, steps);
+    std::cout << "  bricked: " << bricked << " ms/step" << std::endl;
+    std::cout << "  speedup: " << flat / bricked << "x" << std::endl;
+
+    defaultGridLayout() = previous;
+  }
+
+  /**
+   * Step time and level set memory with dense and sparse distance fields.
+   */
+  void levelSetStorage(unsigned int n, unsigned int steps) {
+    GridLayout previous = levelSetLayout();
+    GridLayout layouts[] = {GridLayout::FLAT, GridLayout::SPARSE};
+    std::string names[] = {"dense: ", "sparse:"};
+
+    for (int l = 0; l < 2; ++l) {
+      levelSetLayout() = layouts[l];
+      State *initialState = createInitialState(n);
+      Simulator sim(*initialState, 0.1f);
+      delete initialState;
+
+      Clock::time_point start = Clock::now();
+      for (unsigned int i = 0; i < steps; ++i) {
+        sim.step(0.1f);
+      }
+      double ms = millisecondsSince(start) / steps;
+
+      State *state = sim.getCurrentState();
+      double megabytes = (state->getSignedDistanceGrid()->storageSize()*sizeof(float) +
+                          state->getClosestPointGrid()->storageSize()*sizeof(glm::vec3)) / (1024.0*1024.0);
+      std::cout << "  " << names[l] << " " << ms << " ms/step, "
+                << megabytes << " MB in distance and closest point fields" << std::endl;
+    }
+
+    levelSetLayout() = previous;
+  }
+
+  /**
+   * Time a setForEach kernel through std::function, as before, and inlined.
+   */
+  template <class T, class Kernel>
+  void compareKernel(const std::string &name, Grid<T> &grid, Kernel kernel, unsigned int repetitions) {
+    std::function<T (unsigned int, unsigned int, unsigned int)> indirect = kernel;
+
+    Clock::time_point start = Clock::now();
+    for (unsigned int r = 0; r < repetitions; ++r) {
+      grid.setForEach(indirect);
+    }
+    double before = millisecondsSince(start) / repetitions;
+
+    start = Clock::now();
+    for (unsigned int r = 0; r < repetitions; ++r) {
+      grid.setForEach(kernel);
+    }
+    double after = millisecondsSince(start) / repetitions;
+
+    printf("  %-14s %8.3f ms -> %8.3f ms (%.2fx)\n", name.c_str(), before, after, before / after);
+  }
+
+  /**
+   * Per-kernel cost of std::function dispatch against template kernels.
+   */
+  void kernels(unsigned int n, unsigned int steps) {
+    State *state = createInitialState(n);
+    Grid<CellType> const *cellTypes = state->getCellTypeGrid();
+    OrdinalGrid<float> const *distance = state->getSignedDistanceGrid();
+    unsigned int repetitions = steps*4;
+
+    OrdinalGrid<float> u(n + 1, n, n);
+    OrdinalGrid<float> v(n, n + 1, n);
+    OrdinalGrid<float> w(n, n, n + 1);
+    OrdinalGrid<float> divergence(n, n, n);
+    Grid<CellType> newCellTypes(*cellTypes);
+    Grid<float> correction(n, n, n);
+
+    compareKernel("gravity", u, [&](unsigned int i, unsigned int j, unsigned int k) {
+        if (i < n && cellTypes->get(i, j, k) == CellType::FLUID) {
+          return u.get(i, j, k) - 0.05f;
+        }
+        return u.get(i, j, k);
+      }, repetitions);
+
+    compareKernel("divergence", divergence, [&](unsigned int i, unsigned int j, unsigned int k) {
+        if (cellTypes->get(i, j, k) == CellType::FLUID) {
+          float entering = u.get(i, j, k) + v.get(i, j, k) + w.get(i, j, k);
+          float leaving = u.get(i + 1, j, k) + v.get(i, j + 1, k) + w.get(i, j, k + 1);
+          return entering - leaving;
+        }
+        return 0.0f;
+      }, repetitions);
+
+    compareKernel("cell types", newCellTypes, [&](unsigned int i, unsigned int j, unsigned int k) {
+        if (cellTypes->get(i, j, k) == CellType::SOLID) {
+          return CellType::SOLID;
+        }
+        return distance->get(i, j, k) > 0 ? CellType::EMPTY : CellType::FLUID;
+      }, repetitions);
+
+    compareKernel("correction", correction, [&](unsigned int i, unsigned int j, unsigned int k) {
+        return distance->get(i, j, k);
+      }, repetitions);
+
+    // fluid volume, serial loop against reduction
+    Clock::time_point start = Clock::now();
+    unsigned int serialCount = 0;
+    for (unsigned int r = 0; r < repetitions; ++r) {
+      serialCount = 0;
+      for (unsigned int k = 0; k < n; ++k) {
+        for (unsigned int j = 0; j < n; ++j) {
+          for (unsigned int i = 0; i < n; ++i) {
+            serialCount += cellTypes->get(i, j, k) == CellType::FLUID ? 1 : 0;
+          }
+        }
+      }
+    }
+    double before = millisecondsSince(start) / repetitions;
+
+    start = Clock::now();
+    unsigned int reducedCount = 0;
+    for (unsigned int r = 0; r < repetitions; ++r) {
+      reducedCount = cellTypes->reduce(0u, [&](unsigned int i, unsigned int j, unsigned int k) {
+          return cellTypes->get(i, j, k) == CellType::FLUID ? 1u : 0u;
+        }, [](unsigned int a, unsigned int b) {
+          return a + b;
+        });
+    }
+    double after = millisecondsSince(start) / repetitions;
+    printf("  %-14s %8.3f ms -> %8.3f ms (%.2fx)%s\n", "fluid volume", before, after, before / after,
+           serialCount == reducedCount ? "" : " MISMATCH");
+
+    delete state;
+  }
+
+  /**
+   * Catmull-Rom sampling of a distance field with bounds checked reads and through a halo.
+   */
+  void halo(unsigned int n, unsigned int steps) {
+    State *state = createInitialState(n);
+    OrdinalGrid<float> checked(*state->getSignedDistanceGrid());
+    OrdinalGrid<float> haloed(checked);
+    haloed.setHalo(1, HaloPolicy::ZERO);
+    OrdinalGrid<float> result(n, n, n);
+
+    // sample slightly off the cell centres, like a backtrace does
+    auto sample = [&](OrdinalGrid<float> &grid) {
+      Clock::time_point start = Clock::now();
+      for (unsigned int s = 0; s < steps; ++s) {
+        result.setForEach([&](unsigned int i, unsigned int j, unsigned int k) {
+            return grid.getCrerp(i - 0.3f, j + 0.6f, k - 0.45f);
+          });
+      }
+      return millisecondsSince(start) / steps;
+    };
+
+    double before = sample(checked);
+    double after = sample(haloed);
+    printf("  %-14s %8.3f ms -> %8.3f ms (%.2fx)\n", "getCrerp", before, after, before / after);
+    delete state;
+  }
+
+  /**
+   * Velocity samples at n^3 scattered points, one at a time and batched.
+   */
+  void sampling(unsigned int n, unsigned int steps) {
+    VelocityGrid velocities(n, n, n);
+    velocities.u->setForEach([](unsigned int i, unsigned int j, unsigned int k) { return float(j % 5); });
+    velocities.v->setForEach([](unsigned int i, unsigned int j, unsigned int k) { return float(k % 3); });
+    velocities.w->setForEach([](unsigned int i, unsigned int j, unsigned int k) { return float(i % 7); });
+
+    std::vector<glm::vec3> positions(n*n*n);
+    for (auto &p : positions) {
+      p = glm::vec3(rand() % (n*100), rand() % (n*100), rand() % (n*100)) / 100.0f;
+    }
+    std::vector<glm::vec3> single(positions.size());
+    std::vector<glm::vec3> batched(positions.size());
+
+    Clock::time_point start = Clock::now();
+    for (unsigned int s = 0; s < steps; ++s) {
+      for (unsigned int p = 0; p < positions.size(); ++p) {
+        single[p] = velocities.getLerp(positions[p]);
+      }
+    }
+    double before = millisecondsSince(start) / steps;
+
+    start = Clock::now();
+    for (unsigned int s = 0; s < steps; ++s) {
+      velocities.getLerp(positions.data(), batched.data(), positions.size());
+    }
+    double after = millisecondsSince(start) / steps;
+    printf("  %-14s %8.3f ms -> %8.3f ms (%.2fx)%s\n", "getLerp", before, after, before / after,
+           single == batched ? "" : " MISMATCH");
+  }
+
+  /**
+   * Pressure solve with the assembled sparse matrix and with the matrix-free stencil,
+   * preconditioned with MIC(0) and with multigrid.
+   */
+  void pressure(unsigned int n, unsigned int steps) {
+    State *initialState = createInitialState(n);
+    Simulator sim(*initialState, 0.1f);
+    delete initialState;
+    sim.step(0.1f);
+    sim.step(0.1f);
+
+    State *state = sim.getCurrentState();
+    OrdinalGrid<float> const *divergence = sim.getDivergenceGrid();
+    OrdinalGrid<double> pressures(n, n, n);
+
+    MICSolver assembled(n*n*n);
+    Clock::time_point start = Clock::now();
+    for (unsigned int s = 0; s < steps; ++s) {
+      assembled.solve(divergence, state, &pressures, 0.1f);
+    }
+    printf("  %-20s %8.3f ms\n", "assembled MIC(0)", millisecondsSince(start) / steps);
+
+    std::string names[] = {"stencil MIC(0)", "stencil multigrid"};
+    Preconditioner *preconditioners[] = {new MICPreconditioner(), new MultigridPreconditioner()};
+    for (int p = 0; p < 2; ++p) {
+      StencilPCGSolver stencil(preconditioners[p]);
+      start = Clock::now();
+      for (unsigned int s = 0; s < steps; ++s) {
+        stencil.solve(divergence, state, &pressures, 0.1f);
+      }
+      printf("  %-20s %8.3f ms, %d iterations\n", names[p].c_str(), millisecondsSince(start) / steps,
+             stencil.getIterations());
+    }
+  }
+
+  /**
+   * PCG iterations per step started from zero and from the previous step's pressure,
+   * both solving the divergence of the same simulation of a pool of still water.
+   */
+  void warmStart(unsigned int n, unsigned int steps) {
+    State *initialState = new State(n, n, n);
+    LevelSet *ls = factory::levelSet::pool(n, n, n);
+    initialState->setLevelSet(ls);
+    VelocityGrid *velocities = new VelocityGrid(n, n, n);
+    initialState->setVelocityGrid(velocities);
+    delete velocities;
+    delete ls;
+
+    Simulator sim(*initialState, 0.1f);
+    delete initialState;
+    sim.step(0.1f);
+
+    StencilPCGSolver cold, warm;
+    warm.setWarmStart(true);
+    OrdinalGrid<double> coldPressures(n, n, n);
+    OrdinalGrid<double> warmPressures(n, n, n);
+
+    int coldIterations = 0;
+    int warmIterations = 0;
+    double coldMs = 0.0;
+    double warmMs = 0.0;
+    for (unsigned int s = 0; s < steps; ++s) {
+      sim.step(0.1f);
+      State *state = sim.getCurrentState();
+      OrdinalGrid<float> const *divergence = sim.getDivergenceGrid();
+
+      Clock::time_point start = Clock::now();
+      cold.solve(divergence, state, &coldPressures, 0.1f);
+      coldMs += millisecondsSince(start);
+      start = Clock::now();
+      warm.solve(divergence, state, &warmPressures, 0.1f);
+      warmMs += millisecondsSince(start);
+
+      coldIterations += cold.getIterations();
+      warmIterations += warm.getIterations();
+    }
+    printf("  %-6s %6d iterations %8.3f ms/solve\n", "cold:", coldIterations, coldMs / steps);
+    printf("  %-6s %6d iterations %8.3f ms/solve\n", "warm:", warmIterations, warmMs / steps);
+    printf("  saved: %d iterations (%.0f%%)\n", coldIterations - warmIterations,
+           coldIterations > 0 ? 100.0*(coldIterations - warmIterations)/coldIterations : 0.0);
+  }
+
+  /**
+   * Pressure solve time of every preconditioner with 1 to 32 threads.
+   */
+  void preconditionerScaling(unsigned int n, unsigned int steps) {
+    State *initialState = createInitialState(n);
+    Simulator sim(*initialState, 0.1f);
+    delete initialState;
+    sim.step(0.1f);
+    sim.step(0.1f);
+
+    State *state = sim.getCurrentState();
+    OrdinalGrid<float> const *divergence = sim.getDivergenceGrid();
+    OrdinalGrid<double> pressures(n, n, n);
+
+#ifdef _OPENMP
+    const int previousThreads = omp_get_max_threads();
+    printf("  %d processors\n", omp_get_num_procs());
+#else
+    std::cout << "  built without OpenMP, every run is sequential" << std::endl;
+#endif
+    std::string names[] = {"mic", "mic-parallel", "multigrid"};
+    for (const std::string &name : names) {
+      printf("  %-14s", name.c_str());
+      for (int threads = 1; threads <= 32; threads *= 2) {
+#ifdef _OPENMP
+        omp_set_num_threads(threads);
+#endif
+        StencilPCGSolver solver(factory::preconditioner::byName(name));
+        solver.solve(divergence, state, &pressures, 0.1f);
+        Clock::time_point start = Clock::now();
+        for (unsigned int s = 0; s < steps; ++s) {
+          solver.solve(divergence, state, &pressures, 0.1f);
+        }
+        printf(" %2dt %8.3f ms", threads, millisecondsSince(start) / steps);
+      }
+      printf("\n");
+    }
+#ifdef _OPENMP
+    omp_set_num_threads(previousThreads);
+#endif
+  }
+
+  /**
+   * LevelSet::reinitialize with fast marching, with fast marching limited to the
+   * clamped band and with fast sweeping, and how far apart the distances of the
+   * unlimited methods are within the band. Then the band of 5 once more after a
+   * local change, from scratch and incrementally.
+   */
+  void reinitialization(unsigned int n, unsigned int steps) {
+    LevelSet *ls = factory::levelSet::ball(n, n, n);
+    LevelSet *ls2 = factory::levelSet::stairs(n, n, n);
+    ls->merge(ls2);
+    delete ls2;
+
+    std::string names[] = {"fast marching:", "fast sweeping:", "band of 5:"};
+    ReinitializationMethod methods[] = {ReinitializationMethod::FAST_MARCHING, ReinitializationMethod::FAST_SWEEPING,
+                                        ReinitializationMethod::FAST_MARCHING};
+    LevelSet *results[3];
+    for (int m = 0; m < 3; ++m) {
+      results[m] = nullptr;
+      double ms = 0.0;
+      for (unsigned int s = 0; s < steps; ++s) {
+        delete results[m];
+        results[m] = new LevelSet(*ls);
+        results[m]->setReinitializationMethod(methods[m]);
+        if (m == 2) {
+          results[m]->setBandWidth(5.0f);
+        }
+        Clock::time_point start = Clock::now();
+        results[m]->reinitialize();
+        ms += millisecondsSince(start);
+      }
+      printf("  %-15s %8.3f ms\n", names[m].c_str(), ms / steps);
+    }
+
+    double sum = 0.0;
+    float maxDifference = 0.0f;
+    unsigned int count = 0;
+    for (unsigned int k = 0; k < n; ++k) {
+      for (unsigned int j = 0; j < n; ++j) {
+        for (unsigned int i = 0; i < n; ++i) {
+          const float marched = results[0]->getDistanceGrid()->get(i, j, k);
+          if (glm::abs(marched) < 5.0f) {
+            const float difference = glm::abs(marched - results[1]->getDistanceGrid()->get(i, j, k));
+            maxDifference = glm::max(maxDifference, difference);
+            sum += difference;
+            count++;
+          }
+        }
+      }
+    }
+    printf("  difference in the band: mean %.4f, max %.4f cells\n", count > 0 ? sum / count : 0.0, maxDifference);
+
+    // a droplet appears near a corner of the band of 5, which is then reinitialized
+    // from scratch and only around the droplet
+    const glm::vec3 droplet(0.8f*n, 0.8f*n, 0.8f*n);
+    const float dropletRadius = 2.0f;
+    std::string dropNames[] = {"drop, full:", "drop, tiles:"};
+    for (int incremental = 0; incremental < 2; ++incremental) {
+      double ms = 0.0;
+      for (unsigned int s = 0; s < steps; ++s) {
+        LevelSet banded(*results[2]);
+        banded.setBandWidth(5.0f);
+        banded.setIncrementalReinitialization(incremental == 1);
+        banded.reinitialize();
+        banded.distanceGrid->setForEach([&](unsigned int i, unsigned int j, unsigned int k) {
+            return glm::min(banded.distanceGrid->get(i, j, k), glm::distance(glm::vec3(i, j, k), droplet) - dropletRadius);
+          });
+        Clock::time_point start = Clock::now();
+        banded.reinitialize();
+        ms += millisecondsSince(start);
+      }
+      printf("  %-15s %8.3f ms\n", dropNames[incremental].c_str(), ms / steps);
+    }
+
+    for (LevelSet *result : results) {
+      delete result;
+    }
+    delete ls;
+  }
+
+  /**
+   * Grows distances from the centre of an n^3 grid in the order the queue pops
+   * its cells, the way fast marching uses it, and returns the wall time.
+   */
+  template <typename Queue>
+  double timeMarch(unsigned int n) {
+    OrdinalGrid<float> distances(n, n, n);
+    distances.setForEach([](unsigned int i, unsigned int j, unsigned int k) {
+        return std::numeric_limits<float>::infinity();
+      });
+    const glm::vec3 centre(n/2.0f + 0.3f, n/2.0f + 0.1f, n/2.0f + 0.2f);
+    Queue queue(n, n, n, &distances);
+
+    Clock::time_point start = Clock::now();
+    const GridCoordinate seed(n/2, n/2, n/2);
+    distances.set(seed, glm::distance(glm::vec3(seed), centre));
+    queue.insert(seed);
+    const GridCoordinate offsets[] = {GridCoordinate(1, 0, 0), GridCoordinate(-1, 0, 0), GridCoordinate(0, 1, 0),
+                                      GridCoordinate(0, -1, 0), GridCoordinate(0, 0, 1), GridCoordinate(0, 0, -1)};
+    while (!queue.empty()) {
+      const GridCoordinate c = queue.pop();
+      for (const GridCoordinate &offset : offsets) {
+        const GridCoordinate neighbor = c + offset;
+        if (neighbor.x < 0 || neighbor.y < 0 || neighbor.z < 0 ||
+            neighbor.x >= (int)n || neighbor.y >= (int)n || neighbor.z >= (int)n) {
+          continue;
+        }
+        const float distance = glm::distance(glm::vec3(neighbor), centre);
+        if (distance < distances.get(neighbor)) {
+          distances.set(neighbor, distance);
+          queue.insert(neighbor);
+        }
+      }
+    }
+    return millisecondsSince(start);
+  }
+
+  /**
+   * GridHeap against GridBucketQueue from 64^3 up to n^3, every cell inserted and popped.
+   */
+  void queue(unsigned int n, unsigned int steps) {
+    for (unsigned int size = 64; size <= std::max(n, 64u); size *= 2) {
+      double heapMs = 0.0;
+      double bucketMs = 0.0;
+      for (unsigned int s = 0; s < steps; ++s) {
+        heapMs += timeMarch<GridHeap>(size);
+        bucketMs += timeMarch<GridBucketQueue>(size);
+      }
+      printf("  %3u^3  heap %10.3f ms  buckets %10.3f ms  %.2fx\n",
+             size, heapMs / steps, bucketMs / steps, heapMs / bucketMs);
+    }
+  }
+
+  /**
+   * Simulator::step on a droplet falling through an otherwise empty container,
+   * over the whole domain and within the active region, and how far the level sets
+   * of the two runs are apart afterwards.
+   */
+  void activeRegion(unsigned int n, unsigned int steps) {
+    Simulator *sims[2];
+    std::string names[] = {"whole domain:", "active region:"};
+    for (int restricted = 0; restricted < 2; ++restricted) {
+      State initialState(n, n, n);
+      LevelSet *ls = factory::levelSet::droplet(n, n, n);
+      initialState.setLevelSet(ls);
+      delete ls;
+
+      // the same particles for both runs
+      srand(0);
+      sims[restricted] = new Simulator(initialState, 0.1f);
+      sims[restricted]->setRestrictToActiveRegion(restricted == 1);
+      sims[restricted]->step(0.1f);
+
+      Clock::time_point start = Clock::now();
+      for (unsigned int s = 0; s < steps; ++s) {
+        sims[restricted]->step(0.1f);
+      }
+      printf("  %-15s %8.3f ms/step, %.1f%% of the cells skipped\n", names[restricted].c_str(),
+             millisecondsSince(start) / steps, 100.0f*sims[restricted]->getSkippedFraction());
+    }
+
+    OrdinalGrid<float> const *whole = sims[0]->getCurrentState()->getSignedDistanceGrid();
+    OrdinalGrid<float> const *region = sims[1]->getCurrentState()->getSignedDistanceGrid();
+    float maxDifference = 0.0f;
+    for (unsigned int k = 0; k < n; ++k) {
+      for (unsigned int j = 0; j < n; ++j) {
+        for (unsigned int i = 0; i < n; ++i) {
+          if (glm::abs(whole->get(i, j, k)) < 2.0f) {
+            maxDifference = glm::max(maxDifference, glm::abs(whole->get(i, j, k) - region->get(i, j, k)));
+          }
+        }
+      }
+    }
+    printf("  difference near the surface: max %.4f cells\n", maxDifference);
+
+    delete sims[0];
+    delete sims[1];
+  }
+
+  /**
+   * Backtraces of every u face through the staggered velocities and through the
+   * cell-centred cache, then Simulator::step with and without the cache.
+   */
+  void velocityCache(unsigned int n, unsigned int steps) {
+    VelocityGrid velocities(n, n, n);
+    velocities.u->setForEach([](unsigned int i, unsigned int j, unsigned int k) { return float(j % 5); });
+    velocities.v->setForEach([](unsigned int i, unsigned int j, unsigned int k) { return float(k % 3); });
+    velocities.w->setForEach([](unsigned int i, unsigned int j, unsigned int k) { return float(i % 7); });
+    VelocityCache cache(n, n, n);
+    std::vector<glm::vec3> positions(n + 1);
+
+    Clock::time_point start = Clock::now();
+    for (unsigned int s = 0; s < steps; ++s) {
+      for (unsigned int k = 0; k < n; ++k) {
+        for (unsigned int j = 0; j < n; ++j) {
+          util::advect::mac::backTrackRowU(&velocities, 0, j, k, n + 1, 0.1f, positions.data());
+        }
+      }
+    }
+    double before = millisecondsSince(start) / steps;
+
+    start = Clock::now();
+    for (unsigned int s = 0; s < steps; ++s) {
+      cache.update(&velocities);
+      for (unsigned int k = 0; k < n; ++k) {
+        for (unsigned int j = 0; j < n; ++j) {
+          util::advect::mac::backTrackRowU(&cache, 0, j, k, n + 1, 0.1f, positions.data());
+        }
+      }
+    }
+    double after = millisecondsSince(start) / steps;
+    printf("  %-15s %8.3f ms -> %8.3f ms (%.2fx), including the cache update\n", "backTrackRowU",
+           before, after, before / after);
+
+    Simulator *sims[2];
+    std::string names[] = {"faces:", "cache:"};
+    for (int cached = 0; cached < 2; ++cached) {
+      State *initialState = createInitialState(n);
+      srand(0);
+      sims[cached] = new Simulator(*initialState, 0.1f);
+      delete initialState;
+      sims[cached]->setUseVelocityCache(cached == 1);
+      sims[cached]->step(0.1f);
+
+      start = Clock::now();
+      for (unsigned int s = 0; s < steps; ++s) {
+        sims[cached]->step(0.1f);
+      }
+      printf("  %-15s %8.3f ms/step\n", names[cached].c_str(), millisecondsSince(start) / steps);
+    }
+
+    OrdinalGrid<float> const *faces = sims[0]->getCurrentState()->getSignedDistanceGrid();
+    OrdinalGrid<float> const *cached = sims[1]->getCurrentState()->getSignedDistanceGrid();
+    float maxDifference = 0.0f;
+    for (unsigned int k = 0; k < n; ++k) {
+      for (unsigned int j = 0; j < n; ++j) {
+        for (unsigned int i = 0; i < n; ++i) {
+          if (glm::abs(faces->get(i, j, k)) < 2.0f) {
+            maxDifference = glm::max(maxDifference, glm::abs(faces->get(i, j, k) - cached->get(i, j, k)));
+          }
+        }
+      }
+    }
+    printf("  difference near the surface: max %.4f cells\n", maxDifference);
+
+    delete sims[0];
+    delete sims[1];
+  }
+
+  /**
+   * Advection of the velocities and distances with the distances advected everywhere
+   * and only near the interface.
+   */
+  void distanceBand(unsigned int n, unsigned int steps) {
+    State *initialState = createInitialState(n);
+    srand(0);
+    Simulator sim(*initialState, 0.1f);
+    delete initialState;
+    sim.setRestrictToActiveRegion(false);
+    sim.step(0.1f);
+    sim.step(0.1f);
+
+    State *state = sim.getCurrentState();
+    State advected(*state);
+    const float widths[] = {std::numeric_limits<float>::infinity(), 5.0f, 2.0f};
+    std::string names[] = {"everywhere:", "band 5:", "band 2:"};
+    for (int b = 0; b < 3; ++b) {
+      sim.setDistanceAdvectionBand(widths[b]);
+      Clock::time_point start = Clock::now();
+      for (unsigned int s = 0; s < steps; ++s) {
+        sim.advect(state, &advected, sim.getDeltaT());
+      }
+      printf("  %-15s %8.3f ms\n", names[b].c_str(), millisecondsSince(start) / steps);
+    }
+  }
+
+  std::vector<Benchmark> benchmarks() {
+    return {
+      {"grid-layout", "Simulator::step with flat and bricked grids", gridLayout},
+      {"level-set", "Simulator::step and memory with dense and sparse level sets", levelSetStorage},
+      {"kernels", "setForEach kernels with std::function and template dispatch", kernels},
+      {"halo", "Catmull-Rom sampling with bounds checks and with a ghost cell halo", halo},
+      {"sampling", "VelocityGrid::getLerp one point at a time and batched", sampling},
+      {"pressure", "Pressure solve assembled, matrix-free, and with multigrid", pressure},
+      {"warm-start", "Pressure solver iterations in a still pool from zero and from the previous pressure", warmStart},
+      {"preconditioner-scaling", "Pressure solve time per preconditioner from 1 to 32 threads", preconditionerScaling},
+      {"reinitialization", "Level set reinitialization with fast marching and fast sweeping", reinitialization},
+      {"queue", "Fast marching order from a binary heap and from distance buckets, 64^3 up to n^3", queue},
+      {"active-region", "Simulator::step on a falling droplet over the whole domain and the active region", activeRegion},
+      {"velocity-cache", "Backtraces and Simulator::step through face velocities and a cell-centred cache", velocityCache},
+      {"distance-band", "Simulator::advect with the distances advected everywhere and near the interface only", distanceBand}
+    };
+  }
+}
+
+int main(int argc, char* argv[]) {
+  unsigned int n = 64;
+  unsigned int steps = 5;
+  std::string only = "";
+
+  for (int i = 0; i < argc; i++) {
+    std::string v = argv[i];
+    if (v == "-n") {
+      if (++i < argc) {
+        n = std::stoi(argv[i]);
+      } else {
+        std::cout << "No resolution specified after -n" << std::endl;
+      }
+    }
+    if (v == "-s") {
+      if (++i < argc) {
+        steps = std::stoi(argv[i]);
+      } else {
+        std::cout << "No step count specified after -s" << std::endl;
+      }
+    }
+    if (v == "-b") {
+      if (++i < argc) {
+        only = std::string(argv[i]);
+      } else {
+        std::cout << "No benchmark specified after -b" << std::endl;
+      }
+    }
+    if (v == "-h") {
+      printf("-n <#>        - grid resolution (n x n x n)\n");
+      printf("-s <#>        - number of timed steps\n");
+      printf("-b <name>     - only run the named benchmark\n");
+      printf("-h            - this help message\n");
+      printf("\nbenchmarks:\n");
+      for (auto &b : benchmarks()) {
+        printf("%-14s- %s\n", b.name.c_str(), b.description.c_str());
+      }
+      return 0;
+    }
+  }
+
+  srand(0);
+
+  for (auto &b : benchmarks()) {
+    if (only != "" && only != b.name) {
+      continue;
+    }
+    std::cout << b.name << " (" << n << "^3, " << steps << " steps)" << std::endl;
+    b.run(n, steps);
+  }
+  return 0;
+}
@@ -18,6 +18,7 @@
 #include <sys/types.h>
 
 #include <factories/levelSetFactories.h>
+#include <factories/preconditionerFactories.h>
 #include <ordinalGrid.h>
 #include <state.h>
 #include <simulator.h>
@@ -46,6 +47,11 @@ int main(int argc, char* argv[]) {
   bool useBubbleSpawning = true;
   bool usePls = true;
   bool shortcut = false;
+  bool warmStartPressure = false;
+  std::string preconditionerName = "mic";
+  int extrapolationDepth = -1;
+  bool useVelocityCache = false;
+  float distanceBand = -1.0f;
 
   for (int i = 0; i < argc; i++) {
     std::string v = argv[i];
@@ -103,6 +109,38 @@ int main(int argc, char* argv[]) {
       shortcut = true;
     }
 
+    if (v == "-warm-start") {
+      warmStartPressure = true;
+    }
+
+    if (v == "-preconditioner") {
+      if (++i < argc) {
+        preconditionerName = std::string(argv[i]);
+      } else {
+        std::cout << "No preconditioner specified after -preconditioner" << std::endl;
+      }
+    }
+
+    if (v == "-velocity-cache") {
+      useVelocityCache = true;
+    }
+
+    if (v == "-distance-band") {
+      if (++i < argc) {
+        distanceBand = std::stof(argv[i]);
+      } else {
+        std::cout << "No width specified after -distance-band" << std::endl;
+      }
+    }
+
+    if (v == "-extrapolation-depth") {
+      if (++i < argc) {
+        extrapolationDepth = std::stoi(argv[i]);
+      } else {
+        std::cout << "No depth specified after -extrapolation-depth" << std::endl;
+      }
+    }
+
     if (v == "-h") {
       printf("-r            - show real time ray casted rendering\n");
       printf("-o <dir>      - specify output folder for states\n");
@@ -113,6 +151,11 @@ int main(int argc, char* argv[]) {
       printf("-h            - this help message\n");
       printf("-no-pls       - deactivate particle level set (also deactivates bubble spawning)\n");
       printf("-no-spawning  - deactivate spawning bubbles\n");
+      printf("-warm-start   - start each pressure solve from the previous pressure\n");
+      printf("-preconditioner <name> - pressure preconditioner: mic (default), mic-parallel or multigrid\n");
+      printf("-extrapolation-depth <#> - layers of faces the velocity is extrapolated into (default 4)\n");
+      printf("-velocity-cache - backtrace through velocities averaged to the cell centres\n");
+      printf("-distance-band <width> - only advect the distances this close to the interface\n");
       return 0;
     }
   }
@@ -169,8 +212,20 @@ int main(int argc, char* argv[]) {
 
   delete ls;
     
+  Preconditioner *preconditioner = factory::preconditioner::byName(preconditionerName);
+  if (preconditioner == nullptr) {
+    std::cout << "Unknown preconditioner " << preconditionerName << ", using mic" << std::endl;
+  }
+
   // init simulator
-  Simulator sim(initialState, 0.1f, usePls, useBubbleSpawning);
+  Simulator sim(initialState, 0.1f, usePls, useBubbleSpawning, warmStartPressure, preconditioner);
+  if (extrapolationDepth >= 0) {
+    sim.setExtrapolationDepth(extrapolationDepth);
+  }
+  sim.setUseVelocityCache(useVelocityCache);
+  if (distanceBand >= 0.0f) {
+    sim.setDistanceAdvectionBand(distanceBand);
+  }
 
   BubbleConfig *bubbleConfig = nullptr;
 
@@ -250,7 +305,8 @@ int main(int argc, char* argv[]) {
       std::cout << "Exported frame " << i << " as file: " << file << std::endl;
     }
 
-    std::cout << "Simulated frame " << i << std::endl;
+    std::cout << "Simulated frame " << i << ", " << 100.0f*sim.getSkippedFraction()
+              << "% of the cells skipped so far" << std::endl;
     ++i;
   }
 
@@ -0,0 +1,64 @@
+#include <gtest/gtest.h>
+#include <simulator.h>
+#include <state.h>
+#include <levelSet.h>
+#include <ordinalGrid.h>
+#include <factories/levelSetFactories.h>
+#include <glm/glm.hpp>
+#include <cstdlib>
+
+class ActiveRegionTest : public ::testing::Test{
+protected:
+  ActiveRegionTest() {
+    State initialState(n, n, n);
+    LevelSet *ls = factory::levelSet::droplet(n, n, n);
+    initialState.setLevelSet(ls);
+    delete ls;
+    srand(0);
+    sim = new Simulator(initialState, 0.1f);
+  }
+
+  ~ActiveRegionTest() {
+    delete sim;
+  }
+
+  /**
+   * Fluid cells of the current state around where the droplet starts.
+   */
+  unsigned int fluidAroundDroplet() {
+    const glm::vec3 center(n/4.0f, n*0.75f, n/4.0f);
+    OrdinalGrid<float> const *distances = sim->getCurrentState()->getSignedDistanceGrid();
+    unsigned int fluid = 0;
+    for (unsigned int k = 0; k < n; k++) {
+      for (unsigned int j = 0; j < n; j++) {
+        for (unsigned int i = 0; i < n; i++) {
+          if (glm::distance(glm::vec3(i, j, k), center) < n/10.0f + 1.0f && distances->get(i, j, k) <= 0.0f) {
+            fluid++;
+          }
+        }
+      }
+    }
+    return fluid;
+  }
+
+  static constexpr unsigned int n = 32;
+  Simulator *sim;
+};
+
+constexpr unsigned int ActiveRegionTest::n;
+
+TEST_F(ActiveRegionTest, replacedStateDoesNotComeBack) {
+  ASSERT_GT(fluidAroundDroplet(), 0u);
+
+  // a pool far below the droplet, the cells the droplet filled are outside its region
+  State pool(n, n, n);
+  LevelSet *ls = factory::levelSet::pool(n, n, n);
+  pool.setLevelSet(ls);
+  delete ls;
+  sim->setCurrentState(pool);
+  sim->step(0.1f);
+  EXPECT_EQ(0u, fluidAroundDroplet());
+
+  sim->step(0.1f);
+  EXPECT_EQ(0u, fluidAroundDroplet());
+}
@@ -0,0 +1,61 @@
+#include <gtest/gtest.h>
+#include <simulator.h>
+#include <state.h>
+#include <levelSet.h>
+#include <factories/levelSetFactories.h>
+#include <cstdlib>
+#include <limits>
+
+class DistanceBandTest : public ::testing::Test{
+protected:
+  /**
+   * A droplet falling for a few steps, with the distances advected within band.
+   */
+  Simulator *fall(float band) {
+    State initialState(n, n, n);
+    LevelSet *ls = factory::levelSet::droplet(n, n, n);
+    initialState.setLevelSet(ls);
+    delete ls;
+    // the same particles for every run
+    srand(0);
+    Simulator *sim = new Simulator(initialState, 0.1f);
+    sim->setDistanceAdvectionBand(band);
+    for (unsigned int s = 0; s < steps; s++) {
+      sim->step(0.1f);
+    }
+    return sim;
+  }
+
+  static constexpr unsigned int n = 32;
+  static constexpr unsigned int steps = 6;
+};
+
+constexpr unsigned int DistanceBandTest::n;
+constexpr unsigned int DistanceBandTest::steps;
+
+TEST_F(DistanceBandTest, bandedAdvectionKeepsTheCellTypes) {
+  Simulator *everywhere = fall(std::numeric_limits<float>::infinity());
+  Grid<CellType> const *expected = everywhere->getCurrentState()->getCellTypeGrid();
+  for (float band : {0.0f, 1.0f, 3.0f}) {
+    Simulator *banded = fall(band);
+    Grid<CellType> const *types = banded->getCurrentState()->getCellTypeGrid();
+    for (unsigned int k = 0; k < n; k++) {
+      for (unsigned int j = 0; j < n; j++) {
+        for (unsigned int i = 0; i < n; i++) {
+          ASSERT_EQ(expected->get(i, j, k), types->get(i, j, k)) << "band " << band;
+        }
+      }
+    }
+    delete banded;
+  }
+  delete everywhere;
+}
+
+TEST_F(DistanceBandTest, bandIsAtLeastOneCell) {
+  State state(n, n, n);
+  Simulator sim(state);
+  sim.setDistanceAdvectionBand(-2.0f);
+  EXPECT_EQ(Simulator::MIN_DISTANCE_ADVECTION_BAND, sim.getDistanceAdvectionBand());
+  sim.setDistanceAdvectionBand(4.0f);
+  EXPECT_EQ(4.0f, sim.getDistanceAdvectionBand());
+}
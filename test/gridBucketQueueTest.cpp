@@ -0,0 +1,80 @@
+#include <gtest/gtest.h>
+#include <gridBucketQueue.h>
+#include <ordinalGrid.h>
+#include <glm/glm.hpp>
+#include <cmath>
+#include <limits>
+
+class GridBucketQueueTest : public ::testing::Test{
+protected:
+  GridBucketQueueTest() {
+    distances = new OrdinalGrid<float>(8, 8, 8);
+    queue = new GridBucketQueue(8, 8, 8, distances);
+  }
+
+  ~GridBucketQueueTest() {
+    delete queue;
+    delete distances;
+  }
+
+  void insert(GridCoordinate coord, float distance) {
+    distances->set(coord, distance);
+    queue->insert(coord);
+  }
+
+  OrdinalGrid<float> *distances;
+  GridBucketQueue *queue;
+};
+
+TEST_F(GridBucketQueueTest, popsSortedUpToBucketWidth) {
+  // every cell gets a distance, and some of them share a bucket
+  for (unsigned int i = 0; i < 8; i++) {
+    for (unsigned int j = 0; j < 8; j++) {
+      insert(GridCoordinate(i, j, 3), (float)((i*7 + j*13) % 64)*0.05f - 1.6f);
+    }
+  }
+  float previous = 0.0f;
+  unsigned int popped = 0;
+  while (!queue->empty()) {
+    const float distance = std::fabs(distances->get(queue->pop()));
+    EXPECT_GE(distance, previous - GridBucketQueue::BUCKET_WIDTH);
+    previous = std::max(previous, distance);
+    popped++;
+  }
+  EXPECT_EQ(64u, popped);
+}
+
+TEST_F(GridBucketQueueTest, skipsStaleEntries) {
+  insert(GridCoordinate(1, 2, 3), 3.0f);
+  insert(GridCoordinate(4, 4, 4), 2.0f);
+  // the cell moves closer, its entry at 3 is now stale
+  insert(GridCoordinate(1, 2, 3), 1.0f);
+
+  EXPECT_EQ(GridCoordinate(1, 2, 3), queue->pop());
+  EXPECT_EQ(GridCoordinate(4, 4, 4), queue->pop());
+  EXPECT_TRUE(queue->empty());
+}
+
+TEST_F(GridBucketQueueTest, clearAllowsReuse) {
+  insert(GridCoordinate(0, 0, 0), 0.5f);
+  insert(GridCoordinate(7, 7, 7), 4.0f);
+  queue->clear();
+  EXPECT_TRUE(queue->empty());
+
+  insert(GridCoordinate(3, 3, 3), 2.5f);
+  insert(GridCoordinate(2, 2, 2), 1.5f);
+  EXPECT_EQ(GridCoordinate(2, 2, 2), queue->pop());
+  EXPECT_EQ(GridCoordinate(3, 3, 3), queue->pop());
+  EXPECT_TRUE(queue->empty());
+}
+
+TEST_F(GridBucketQueueTest, infiniteDistancesComeLast) {
+  insert(GridCoordinate(5, 5, 5), std::numeric_limits<float>::infinity());
+  insert(GridCoordinate(1, 1, 1), 10.0f);
+  insert(GridCoordinate(2, 2, 2), 0.25f);
+
+  EXPECT_EQ(GridCoordinate(2, 2, 2), queue->pop());
+  EXPECT_EQ(GridCoordinate(1, 1, 1), queue->pop());
+  EXPECT_EQ(GridCoordinate(5, 5, 5), queue->pop());
+  EXPECT_TRUE(queue->empty());
+}
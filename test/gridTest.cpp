@@ -1,5 +1,6 @@
 #include <gtest/gtest.h>
 #include <grid.h>
+#include <sstream>
 class GridTest : public ::testing::Test{
 protected:
   GridTest() {
@@ -19,3 +20,174 @@ TEST_F(GridTest, settingAndGetting) {
   double b = doubleGrid->get(4, 3, 1);
   ASSERT_EQ(a, b);
 }
+
+TEST_F(GridTest, brickedSettingAndGetting) {
+  Grid<double> bricked(13, 9, 17, GridLayout::BRICKED);
+  bricked.setForEach([](unsigned int i, unsigned int j, unsigned int k) {
+      return i + 100.0*j + 10000.0*k;
+    });
+
+  for (unsigned int k = 0; k < 17; ++k) {
+    for (unsigned int j = 0; j < 9; ++j) {
+      for (unsigned int i = 0; i < 13; ++i) {
+        ASSERT_EQ(i + 100.0*j + 10000.0*k, bricked.get(i, j, k));
+      }
+    }
+  }
+}
+
+TEST_F(GridTest, brickedStorageIsContiguousWithinBrick) {
+  Grid<double> bricked(16, 16, 16, GridLayout::BRICKED);
+  unsigned int base = bricked.indexTranslation(8, 8, 8);
+  ASSERT_EQ(base + 1, bricked.indexTranslation(9, 8, 8));
+  ASSERT_EQ(base + 8, bricked.indexTranslation(8, 9, 8));
+  ASSERT_EQ(base + 64, bricked.indexTranslation(8, 8, 9));
+}
+
+TEST_F(GridTest, streamIsIndependentOfLayout) {
+  Grid<double> flat(5, 11, 9, GridLayout::FLAT);
+  Grid<double> bricked(5, 11, 9, GridLayout::BRICKED);
+  flat.setForEach([](unsigned int i, unsigned int j, unsigned int k) {
+      return i - 2.0*j + 3.0*k;
+    });
+
+  std::stringstream stream;
+  flat.write(stream);
+  bricked.read(stream);
+
+  for (unsigned int k = 0; k < 9; ++k) {
+    for (unsigned int j = 0; j < 11; ++j) {
+      for (unsigned int i = 0; i < 5; ++i) {
+        ASSERT_EQ(flat.get(i, j, k), bricked.get(i, j, k));
+      }
+    }
+  }
+}
+
+TEST_F(GridTest, sparseBricksAreOnlyAllocatedWhereValuesDiffer) {
+  Grid<double> sparse(32, 32, 32, GridLayout::SPARSE);
+  ASSERT_EQ(0u, sparse.allocatedBricks());
+
+  sparse.setForEach([](unsigned int i, unsigned int j, unsigned int k) {
+      return k < 12 ? -5.0 : 5.0;
+    });
+  // only the bricks with 8 <= k < 16 straddle the plane
+  ASSERT_EQ(16u, sparse.allocatedBricks());
+  ASSERT_EQ(-5.0, sparse.get(3, 20, 0));
+  ASSERT_EQ(-5.0, sparse.get(3, 20, 11));
+  ASSERT_EQ(5.0, sparse.get(3, 20, 12));
+  ASSERT_EQ(5.0, sparse.get(31, 31, 31));
+  ASSERT_TRUE(sparse.isBrickUniform(0, 0, 0));
+  ASSERT_FALSE(sparse.isBrickUniform(0, 0, 8));
+
+  sparse.set(1, 1, 1, 2.0);
+  ASSERT_EQ(17u, sparse.allocatedBricks());
+  ASSERT_EQ(2.0, sparse.get(1, 1, 1));
+
+  sparse.set(1, 1, 1, -5.0);
+  sparse.prune();
+  ASSERT_EQ(16u, sparse.allocatedBricks());
+
+  Grid<double> copy(sparse);
+  ASSERT_EQ(16u, copy.allocatedBricks());
+  ASSERT_EQ(-5.0, copy.get(3, 20, 11));
+}
+
+TEST_F(GridTest, reduce) {
+  doubleGrid->setForEach([](unsigned int i, unsigned int j, unsigned int k) {
+      return (double)(i + j + k);
+    });
+  double sum = doubleGrid->reduce(0.0, [&](unsigned int i, unsigned int j, unsigned int k) {
+      return doubleGrid->get(i, j, k);
+    }, [](double a, double b) {
+      return a + b;
+    });
+  // each coordinate sums to 45 over 100 cells
+  ASSERT_EQ(3*45*100, sum);
+}
+
+TEST_F(GridTest, setForEachRowAndIndexed) {
+  for (GridLayout layout : {GridLayout::FLAT, GridLayout::BRICKED, GridLayout::SPARSE}) {
+    Grid<double> grid(11, 7, 5, layout);
+    grid.setForEachRow([](unsigned int j, unsigned int k, double *row) {
+        for (unsigned int i = 0; i < 11; ++i) {
+          row[i] = i + 100.0*j + 10000.0*k;
+        }
+      });
+    grid.setForEachIndexed([&](unsigned int i, unsigned int j, unsigned int k, unsigned int index) {
+        return grid.get(index) + 1.0;
+      });
+    ASSERT_EQ(4 + 100.0*6 + 10000.0*3 + 1.0, grid.get(4, 6, 3));
+  }
+}
+
+TEST_F(GridTest, haloGhostCellsFollowPolicy) {
+  Grid<float> grid(4, 3, 2);
+  grid.setForEach([](unsigned int i, unsigned int j, unsigned int k) {
+      return float(i + 10*j + 100*k);
+    });
+
+  grid.setHalo(2, HaloPolicy::ZERO);
+  ASSERT_EQ(2u, grid.getHalo());
+  EXPECT_EQ(0.0f, grid.haloGet(-1, 0, 0));
+  EXPECT_EQ(0.0f, grid.haloGet(4, 2, 1));
+  EXPECT_EQ(0.0f, grid.haloGet(1, -2, 3));
+  EXPECT_EQ(grid.get(3, 2, 1), grid.haloGet(3, 2, 1));
+
+  grid.setHalo(2, HaloPolicy::CLAMP);
+  EXPECT_EQ(grid.get(0, 0, 0), grid.haloGet(-2, -1, 0));
+  EXPECT_EQ(grid.get(3, 2, 1), grid.haloGet(5, 4, 3));
+
+  grid.setHalo(2, HaloPolicy::REFLECT);
+  EXPECT_EQ(grid.get(0, 1, 0), grid.haloGet(-1, 1, 0));
+  EXPECT_EQ(grid.get(1, 1, 0), grid.haloGet(-2, 1, 0));
+  EXPECT_EQ(grid.get(2, 1, 1), grid.haloGet(2, 1, 2));
+
+  // interior values and stream output are unchanged by the halo
+  Grid<float> copy(grid);
+  std::stringstream stream;
+  copy.write(stream);
+  Grid<float> read(4, 3, 2);
+  read.read(stream);
+  for (unsigned int k = 0; k < 2; k++) {
+    for (unsigned int j = 0; j < 3; j++) {
+      for (unsigned int i = 0; i < 4; i++) {
+        ASSERT_EQ(float(i + 10*j + 100*k), copy.get(i, j, k));
+        ASSERT_EQ(float(i + 10*j + 100*k), read.get(i, j, k));
+      }
+    }
+  }
+}
+
+TEST_F(GridTest, boxRowsAndReduceStayInTheBox) {
+  for (GridLayout layout : {GridLayout::FLAT, GridLayout::BRICKED, GridLayout::SPARSE}) {
+    Grid<double> grid(11, 13, 17, layout);
+    grid.setForEach([](unsigned int i, unsigned int j, unsigned int k) {
+        return -1.0;
+      });
+    // the upper corner reaches past the grid and is clamped
+    const GridCoordinate lower(2, 7, 3);
+    const GridCoordinate upper(5, 20, 9);
+    grid.setForEachRowInBox(lower, upper, [](unsigned int j, unsigned int k, double *row) {
+        for (unsigned int i = 2; i <= 5; ++i) {
+          row[i] = i + 100.0*j + 10000.0*k;
+        }
+      });
+
+    for (unsigned int k = 0; k < 17; ++k) {
+      for (unsigned int j = 0; j < 13; ++j) {
+        for (unsigned int i = 0; i < 11; ++i) {
+          const bool inside = i >= 2 && i <= 5 && j >= 7 && k >= 3 && k <= 9;
+          ASSERT_EQ(inside ? i + 100.0*j + 10000.0*k : -1.0, grid.get(i, j, k));
+        }
+      }
+    }
+
+    const unsigned int cells = grid.reduceInBox(lower, upper, 0u, [](unsigned int i, unsigned int j, unsigned int k) {
+        return 1u;
+      }, [](unsigned int a, unsigned int b) {
+        return a + b;
+      });
+    ASSERT_EQ(4u*6u*7u, cells);
+  }
+}
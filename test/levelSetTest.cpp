@@ -0,0 +1,249 @@
+#include <gtest/gtest.h>
+#include <levelSet.h>
+#include <factories/levelSetFactories.h>
+#include <glm/glm.hpp>
+#include <cmath>
+#include <cstring>
+#include <sstream>
+
+class LevelSetTest : public ::testing::Test{
+protected:
+  LevelSetTest() {
+    n = 24;
+    center = glm::vec3(10.3f, 12.6f, 11.1f);
+    radius = 7.0f;
+    // a ball off the centre of an open container
+    const glm::vec3 c = center;
+    const float r = radius;
+    marched = new LevelSet(n, n, n,
+      [=](const unsigned int &i, const unsigned int &j, const unsigned int &k) {
+        return glm::distance(glm::vec3(i, j, k), c) - r;
+      }, [](unsigned int i, unsigned int j, unsigned int k) {
+        return j == 0 ? CellType::SOLID : CellType::EMPTY;
+      });
+    swept = new LevelSet(*marched);
+    swept->setReinitializationMethod(ReinitializationMethod::FAST_SWEEPING);
+  }
+
+  ~LevelSetTest() {
+    delete marched;
+    delete swept;
+  }
+
+  /**
+   * Mean error against the exact distance of the cells within band of the interface.
+   */
+  float meanError(LevelSet const *levelSet, float band) {
+    float sum = 0.0f;
+    unsigned int count = 0;
+    for (unsigned int k = 0; k < n; k++) {
+      for (unsigned int j = 0; j < n; j++) {
+        for (unsigned int i = 0; i < n; i++) {
+          const float exact = glm::distance(glm::vec3(i, j, k), center) - radius;
+          if (std::fabs(exact) < band) {
+            sum += std::fabs(levelSet->getDistanceGrid()->get(i, j, k) - exact);
+            count++;
+          }
+        }
+      }
+    }
+    return sum/count;
+  }
+
+  unsigned int n;
+  glm::vec3 center;
+  float radius;
+  LevelSet *marched;
+  LevelSet *swept;
+};
+
+TEST_F(LevelSetTest, fastSweepingMatchesFastMarching) {
+  marched->reinitialize();
+  swept->reinitialize();
+
+  for (unsigned int k = 0; k < n; k++) {
+    for (unsigned int j = 0; j < n; j++) {
+      for (unsigned int i = 0; i < n; i++) {
+        const float distance = swept->getDistanceGrid()->get(i, j, k);
+        ASSERT_EQ(marched->getDistanceGrid()->get(i, j, k) > 0, distance > 0);
+        if (std::fabs(distance) < 5.0f) {
+          const glm::vec3 point = swept->getClosestPointGrid()->get(i, j, k);
+          ASSERT_NEAR(std::fabs(distance), glm::distance(point, glm::vec3(i, j, k)), 1e-4f);
+        }
+      }
+    }
+  }
+
+  // both propagate closest points, so they are about equally far from the exact distance
+  const float marchedError = meanError(marched, 4.0f);
+  EXPECT_LT(marchedError, 0.1f);
+  EXPECT_LT(meanError(swept, 4.0f), 1.2f*marchedError);
+}
+
+TEST_F(LevelSetTest, bandLimitedMarchingMatchesInsideTheBand) {
+  LevelSet banded(*marched);
+  banded.setBandWidth(2.5f);
+  marched->reinitialize();
+  banded.reinitialize();
+
+  for (unsigned int k = 0; k < n; k++) {
+    for (unsigned int j = 0; j < n; j++) {
+      for (unsigned int i = 0; i < n; i++) {
+        const float expected = marched->getDistanceGrid()->get(i, j, k);
+        const float distance = banded.getDistanceGrid()->get(i, j, k);
+        const glm::vec3 point = banded.getClosestPointGrid()->get(i, j, k);
+        if (std::fabs(expected) <= 2.5f) {
+          ASSERT_EQ(expected, distance);
+          ASSERT_EQ(marched->getClosestPointGrid()->get(i, j, k), point);
+        } else {
+          ASSERT_EQ(expected > 0 ? 2.5f : -2.5f, distance);
+          ASSERT_TRUE(LevelSet::isOutsideBand(point));
+        }
+      }
+    }
+  }
+}
+
+TEST_F(LevelSetTest, incrementalReinitializationKeepsUnchangedTiles) {
+  marched->setBandWidth(3.0f);
+  marched->setIncrementalReinitialization(true);
+  marched->reinitialize();
+  OrdinalGrid<float> first(*marched->getDistanceGrid());
+
+  // a reinitialized field has not moved, so no tile is marched again
+  marched->reinitialize();
+  for (unsigned int k = 0; k < n; k++) {
+    for (unsigned int j = 0; j < n; j++) {
+      for (unsigned int i = 0; i < n; i++) {
+        ASSERT_EQ(first.get(i, j, k), marched->getDistanceGrid()->get(i, j, k));
+      }
+    }
+  }
+}
+
+TEST_F(LevelSetTest, incrementalReinitializationFollowsALocalChange) {
+  marched->setBandWidth(3.0f);
+  LevelSet incremental(*marched);
+  incremental.setIncrementalReinitialization(true);
+  marched->reinitialize();
+  incremental.reinitialize();
+
+  // a droplet appears next to the ball
+  const glm::vec3 droplet(20.0f, 19.5f, 20.0f);
+  const float dropletRadius = 2.0f;
+  for (LevelSet *levelSet : {marched, &incremental}) {
+    levelSet->distanceGrid->setForEach([&](unsigned int i, unsigned int j, unsigned int k) {
+        return glm::min(levelSet->distanceGrid->get(i, j, k), glm::distance(glm::vec3(i, j, k), droplet) - dropletRadius);
+      });
+  }
+  marched->reinitialize();
+  incremental.reinitialize();
+
+  for (unsigned int k = 0; k < n; k++) {
+    for (unsigned int j = 0; j < n; j++) {
+      for (unsigned int i = 0; i < n; i++) {
+        const float expected = marched->getDistanceGrid()->get(i, j, k);
+        const float distance = incremental.getDistanceGrid()->get(i, j, k);
+        ASSERT_EQ(expected > 0, distance > 0);
+        if (glm::distance(glm::vec3(i, j, k), droplet) < dropletRadius + 2.0f) {
+          ASSERT_NEAR(expected, distance, 1e-5f);
+        } else {
+          // elsewhere both are reinitializations of the same field
+          ASSERT_NEAR(expected, distance, 0.5f);
+        }
+      }
+    }
+  }
+}
+
+TEST_F(LevelSetTest, cellTypeUpdateCountsAndBoundsTheFluid) {
+  marched->reinitialize();
+
+  unsigned int fluidCells = 0;
+  GridCoordinate lower(n), upper(-1);
+  for (unsigned int k = 0; k < n; k++) {
+    for (unsigned int j = 0; j < n; j++) {
+      for (unsigned int i = 0; i < n; i++) {
+        const CellType type = marched->getCellTypeGrid()->get(i, j, k);
+        if (j == 0) {
+          ASSERT_EQ(CellType::SOLID, type);
+        } else {
+          ASSERT_EQ(marched->getDistanceGrid()->get(i, j, k) > 0 ? CellType::EMPTY : CellType::FLUID, type);
+        }
+        if (type == CellType::FLUID) {
+          fluidCells++;
+          lower = glm::min(lower, GridCoordinate(i, j, k));
+          upper = glm::max(upper, GridCoordinate(i, j, k));
+        }
+      }
+    }
+  }
+
+  GridCoordinate fluidLower, fluidUpper;
+  ASSERT_TRUE(marched->getFluidBounds(fluidLower, fluidUpper));
+  ASSERT_EQ(lower, fluidLower);
+  ASSERT_EQ(upper, fluidUpper);
+  // the ball was just built, so its target volume is the current one
+  ASSERT_NEAR(0.0f, marched->getVolumeError(), 1e-6f);
+  ASSERT_GT(fluidCells, 0u);
+}
+
+TEST_F(LevelSetTest, cellTypesAreStoredAsInt32) {
+  marched->reinitialize();
+  std::stringstream stream;
+  marched->write(stream);
+
+  // the distance grid comes first, then the cell types with their own w, h, d
+  const std::string bytes = stream.str();
+  const size_t cells = n*n*n;
+  const size_t typesOffset = 3*sizeof(unsigned int) + cells*sizeof(float) + 3*sizeof(unsigned int);
+  ASSERT_GE(bytes.size(), typesOffset + cells*sizeof(int32_t));
+  for (unsigned int k = 0; k < n; k++) {
+    for (unsigned int j = 0; j < n; j++) {
+      for (unsigned int i = 0; i < n; i++) {
+        int32_t stored;
+        std::memcpy(&stored, bytes.data() + typesOffset + ((k*n + j)*n + i)*sizeof(int32_t), sizeof(stored));
+        ASSERT_EQ((int32_t)marched->getCellTypeGrid()->get(i, j, k), stored);
+      }
+    }
+  }
+
+  LevelSet read(*swept);
+  read.read(stream);
+  for (unsigned int k = 0; k < n; k++) {
+    for (unsigned int j = 0; j < n; j++) {
+      for (unsigned int i = 0; i < n; i++) {
+        ASSERT_EQ(marched->getCellTypeGrid()->get(i, j, k), read.getCellTypeGrid()->get(i, j, k));
+      }
+    }
+  }
+}
+
+TEST_F(LevelSetTest, fastSweepingConvergesAroundSolids) {
+  LevelSet *(*factories[])(unsigned int, unsigned int, unsigned int) = {
+    factory::levelSet::stairs, factory::levelSet::twoPillars
+  };
+  for (auto create : factories) {
+    LevelSet *levelSet = create(n, n, n);
+    LevelSet *sweptAround = new LevelSet(*levelSet);
+    sweptAround->setReinitializationMethod(ReinitializationMethod::FAST_SWEEPING);
+    levelSet->reinitialize();
+    sweptAround->reinitialize();
+    EXPECT_TRUE(sweptAround->getSweepConverged());
+
+    float difference = 0.0f;
+    for (unsigned int k = 0; k < n; k++) {
+      for (unsigned int j = 0; j < n; j++) {
+        for (unsigned int i = 0; i < n; i++) {
+          const float marchedDistance = levelSet->getDistanceGrid()->get(i, j, k);
+          const float sweptDistance = sweptAround->getDistanceGrid()->get(i, j, k);
+          ASSERT_EQ(marchedDistance > 0, sweptDistance > 0);
+          difference = std::max(difference, std::fabs(marchedDistance - sweptDistance));
+        }
+      }
+    }
+    EXPECT_LT(difference, 0.5f);
+    delete levelSet;
+    delete sweptAround;
+  }
+}
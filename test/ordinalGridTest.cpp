@@ -1,6 +1,7 @@
 #include <gtest/gtest.h>
 #include <ordinalGrid.h>
 #include <glm/glm.hpp>
+#include <vector>
 
 class OrdinalGridTest : public ::testing::Test{
 protected:
@@ -66,3 +67,41 @@ TEST_F(OrdinalGridTest, setAndGetVec3){
     EXPECT_EQ(v, glm::vec3(2.5));
   }
 }
+
+TEST_F(OrdinalGridTest, crerpWithHaloMatchesSafeGet) {
+  doubleGrid->setForEach([](unsigned int i, unsigned int j, unsigned int k) {
+      return double((i*7 + j*13 + k*29) % 17);
+    });
+  OrdinalGrid<double> haloed(*doubleGrid);
+  haloed.setHalo(1, HaloPolicy::ZERO);
+
+  float positions[][3] = {
+    {4.25f, 3.5f, 1.75f}, {0.0f, 0.0f, 0.0f}, {0.3f, 8.9f, 9.0f},
+    {9.0f, 9.0f, 9.0f}, {-0.5f, 4.0f, 2.2f}, {12.0f, -3.0f, 5.5f}
+  };
+  for (auto &p : positions) {
+    EXPECT_DOUBLE_EQ(doubleGrid->getCrerp(p[0], p[1], p[2]), haloed.getCrerp(p[0], p[1], p[2]));
+  }
+}
+
+TEST_F(OrdinalGridTest, batchedSamplingMatchesSingleSamples) {
+  doubleGrid->setForEach([](unsigned int i, unsigned int j, unsigned int k) {
+      return double((i*7 + j*13 + k*29) % 17);
+    });
+  OrdinalGrid<double> haloed(*doubleGrid);
+  haloed.setHalo(1, HaloPolicy::ZERO);
+
+  std::vector<glm::vec3> positions;
+  for (int n = 0; n < 37; n++) {
+    positions.push_back(glm::vec3(-1.5f + n*0.33f, 9.5f - n*0.27f, (n*0.71f) - 2.0f));
+  }
+  std::vector<double> lerped(positions.size());
+  std::vector<double> crerped(positions.size());
+  haloed.getLerp(positions.data(), lerped.data(), positions.size());
+  haloed.getCrerp(positions.data(), crerped.data(), positions.size());
+
+  for (unsigned int n = 0; n < positions.size(); n++) {
+    EXPECT_DOUBLE_EQ(doubleGrid->getLerp(positions[n]), lerped[n]);
+    EXPECT_DOUBLE_EQ(doubleGrid->getCrerp(positions[n]), crerped[n]);
+  }
+}
@@ -0,0 +1,185 @@
+#include <gtest/gtest.h>
+#include <simulator.h>
+#include <state.h>
+#include <levelSet.h>
+#include <velocityGrid.h>
+#include <ordinalGrid.h>
+#include <factories/levelSetFactories.h>
+#include <glm/glm.hpp>
+#include <cmath>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+class ProjectionTest : public ::testing::Test{
+protected:
+  ProjectionTest() {
+    State state(n, n, n);
+    LevelSet *ls = factory::levelSet::ball(n, n, n);
+    state.setLevelSet(ls);
+    delete ls;
+
+    // a swirl that is not divergence free, so that the pressure is not zero
+    VelocityGrid velocities(n, n, n);
+    velocities.u->setForEach([](unsigned int i, unsigned int j, unsigned int k) {
+        return std::sin(0.7f*j + 0.3f*k) + 0.05f*i;
+      });
+    velocities.v->setForEach([](unsigned int i, unsigned int j, unsigned int k) {
+        return std::cos(0.5f*i - 0.4f*k) - 0.03f*j;
+      });
+    velocities.w->setForEach([](unsigned int i, unsigned int j, unsigned int k) {
+        return std::sin(0.6f*i + 0.2f*j) + 0.02f*k;
+      });
+    state.setVelocityGrid(&velocities);
+
+    // without the particle level set a step does not depend on rand()
+    sim = new Simulator(state, 1.0f, false, false);
+    sim->step(dt);
+  }
+
+  ~ProjectionTest() {
+    delete sim;
+  }
+
+  /**
+   * Largest speed along axis of the faces with a fluid cell on either side.
+   */
+  float fastestFluidFace(State const *state, OrdinalGrid<float> const *faces, GridCoordinate axis) {
+    Grid<CellType> const *cellTypes = state->getCellTypeGrid();
+    auto isFluid = [&](GridCoordinate cell) {
+      return cell.x >= 0 && cell.y >= 0 && cell.z >= 0 && cell.x < (int)n && cell.y < (int)n && cell.z < (int)n &&
+        cellTypes->get(cell.x, cell.y, cell.z) == CellType::FLUID;
+    };
+    float fastest = 0.0f;
+    for (unsigned int k = 0; k < faces->getD(); k++) {
+      for (unsigned int j = 0; j < faces->getH(); j++) {
+        for (unsigned int i = 0; i < faces->getW(); i++) {
+          const GridCoordinate after(i, j, k);
+          if (isFluid(after) || isFluid(after - axis)) {
+            fastest = std::max(fastest, std::fabs(faces->get(i, j, k)));
+          }
+        }
+      }
+    }
+    return fastest;
+  }
+
+  /**
+   * Divergence and gradient subtraction of the current state, into copies.
+   */
+  void project(State &state, OrdinalGrid<float> &divergence, glm::vec3 g, glm::vec3 &fastest) {
+    sim->calculateNegativeDivergence(&state, &divergence, g, dt);
+    fastest = sim->gradientSubtraction(&state, g, dt);
+  }
+
+  void expectSameFaces(State const &a, State const &b) {
+    OrdinalGrid<float> const *facesA[] = {a.getVelocityGrid()->u, a.getVelocityGrid()->v, a.getVelocityGrid()->w};
+    OrdinalGrid<float> const *facesB[] = {b.getVelocityGrid()->u, b.getVelocityGrid()->v, b.getVelocityGrid()->w};
+    for (int c = 0; c < 3; c++) {
+      expectSameGrid(facesA[c], facesB[c]);
+    }
+  }
+
+  void expectSameGrid(OrdinalGrid<float> const *a, OrdinalGrid<float> const *b) {
+    for (unsigned int k = 0; k < a->getD(); k++) {
+      for (unsigned int j = 0; j < a->getH(); j++) {
+        for (unsigned int i = 0; i < a->getW(); i++) {
+          ASSERT_EQ(a->get(i, j, k), b->get(i, j, k));
+        }
+      }
+    }
+  }
+
+  static constexpr unsigned int n = 16;
+  static constexpr float dt = 0.1f;
+  const glm::vec3 gravity = glm::vec3(0.1f, -0.5f, 0.2f);
+  Simulator *sim;
+};
+
+constexpr unsigned int ProjectionTest::n;
+constexpr float ProjectionTest::dt;
+
+TEST_F(ProjectionTest, fastestFacesMatchTheFluidFaces) {
+  State *state = sim->getCurrentState();
+  const glm::vec3 fastest = sim->gradientSubtraction(state, gravity, dt);
+
+  VelocityGrid const *velocities = state->getVelocityGrid();
+  EXPECT_EQ(fastestFluidFace(state, velocities->u, GridCoordinate(1, 0, 0)), fastest.x);
+  EXPECT_EQ(fastestFluidFace(state, velocities->v, GridCoordinate(0, 1, 0)), fastest.y);
+  EXPECT_EQ(fastestFluidFace(state, velocities->w, GridCoordinate(0, 0, 1)), fastest.z);
+  EXPECT_GT(fastest.x, 0.0f);
+}
+
+TEST_F(ProjectionTest, maxVelocityIsTheFastestFaceOfTheActiveCells) {
+  State *state = sim->getCurrentState();
+  VelocityGrid const *velocities = state->getVelocityGrid();
+  GridCoordinate lower, upper;
+  sim->getActiveRegion(lower, upper);
+
+  glm::vec3 fastest(0.0f);
+  for (int k = lower.z; k <= upper.z; k++) {
+    for (int j = lower.y; j <= upper.y; j++) {
+      for (int i = lower.x; i <= upper.x; i++) {
+        // both faces of the cell along each axis
+        for (int after = 0; after <= 1; after++) {
+          fastest.x = std::max(fastest.x, std::fabs(velocities->u->get(i + after, j, k)));
+          fastest.y = std::max(fastest.y, std::fabs(velocities->v->get(i, j + after, k)));
+          fastest.z = std::max(fastest.z, std::fabs(velocities->w->get(i, j, k + after)));
+        }
+      }
+    }
+  }
+  const glm::vec3 reduced = sim->maxVelocity(velocities);
+  EXPECT_EQ(fastest.x, reduced.x);
+  EXPECT_EQ(fastest.y, reduced.y);
+  EXPECT_EQ(fastest.z, reduced.z);
+}
+
+#ifdef _OPENMP
+TEST_F(ProjectionTest, projectionDoesNotDependOnTheThreadCount) {
+  State single(*sim->getCurrentState());
+  State parallel(*sim->getCurrentState());
+  OrdinalGrid<float> singleDivergence(n, n, n), parallelDivergence(n, n, n);
+  glm::vec3 singleFastest, parallelFastest;
+
+  const int threads = omp_get_max_threads();
+  omp_set_num_threads(1);
+  project(single, singleDivergence, gravity, singleFastest);
+  omp_set_num_threads(4);
+  project(parallel, parallelDivergence, gravity, parallelFastest);
+  omp_set_num_threads(threads);
+
+  expectSameGrid(&singleDivergence, &parallelDivergence);
+  expectSameFaces(single, parallel);
+  EXPECT_EQ(singleFastest, parallelFastest);
+}
+#endif
+
+TEST_F(ProjectionTest, foldedGravityMatchesASeparatePass) {
+  State folded(*sim->getCurrentState());
+  State separate(*sim->getCurrentState());
+  OrdinalGrid<float> foldedDivergence(n, n, n), separateDivergence(n, n, n);
+  glm::vec3 foldedFastest, separateFastest;
+  project(folded, foldedDivergence, gravity, foldedFastest);
+
+  // gravity as its own pass: the face before each fluid cell is accelerated first
+  VelocityGrid const *velocities = separate.getVelocityGrid();
+  OrdinalGrid<float> *faces[] = {velocities->u, velocities->v, velocities->w};
+  Grid<CellType> const *cellTypes = separate.getCellTypeGrid();
+  for (unsigned int k = 0; k < n; k++) {
+    for (unsigned int j = 0; j < n; j++) {
+      for (unsigned int i = 0; i < n; i++) {
+        if (cellTypes->get(i, j, k) == CellType::FLUID) {
+          for (int c = 0; c < 3; c++) {
+            faces[c]->set(i, j, k, faces[c]->get(i, j, k) + gravity[c]*dt);
+          }
+        }
+      }
+    }
+  }
+  project(separate, separateDivergence, glm::vec3(0.0f), separateFastest);
+
+  expectSameGrid(&foldedDivergence, &separateDivergence);
+  expectSameFaces(folded, separate);
+  EXPECT_EQ(foldedFastest, separateFastest);
+}
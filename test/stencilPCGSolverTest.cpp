@@ -0,0 +1,214 @@
+#include <gtest/gtest.h>
+#include <stencilPCGSolver.h>
+#include <micSolver.h>
+#include <multigridPreconditioner.h>
+#include <micPreconditioner.h>
+#include <ordinalGrid.h>
+#include <state.h>
+#include <solidFaces.h>
+#include <pcgsolver/sparse_matrix.h>
+#include <vector>
+
+class StencilPCGSolverTest : public ::testing::Test{
+protected:
+  StencilPCGSolverTest() {
+    n = 12;
+    state = new State(n, n, n);
+    divergence = new OrdinalGrid<float>(n, n, n);
+
+    // a pool of water on a solid floor, with air above and a solid pillar in it
+    Grid<CellType> cellTypes(n, n, n);
+    cellTypes.setForEach([&](unsigned int i, unsigned int j, unsigned int k) {
+        if (j == 0 || (i == 5 && k == 6)) {
+          return CellType::SOLID;
+        }
+        return j < 7 ? CellType::FLUID : CellType::EMPTY;
+      });
+    state->setCellTypeGrid(&cellTypes);
+
+    divergence->setForEach([&](unsigned int i, unsigned int j, unsigned int k) {
+        if (cellTypes.get(i, j, k) != CellType::FLUID) {
+          return 0.0f;
+        }
+        return float((i*7 + j*3 + k*5) % 11) - 5.0f;
+      });
+  }
+
+  ~StencilPCGSolverTest() {
+    delete divergence;
+    delete state;
+  }
+
+  unsigned int n;
+  State *state;
+  OrdinalGrid<float> *divergence;
+};
+
+TEST_F(StencilPCGSolverTest, matchesAssembledSolver) {
+  OrdinalGrid<double> expected(n, n, n);
+  OrdinalGrid<double> pressure(n, n, n);
+  MICSolver assembled(n*n*n);
+  StencilPCGSolver stencil;
+
+  ASSERT_TRUE(assembled.solve(divergence, state, &expected, 0.1f));
+  ASSERT_TRUE(stencil.solve(divergence, state, &pressure, 0.1f));
+  EXPECT_GT(stencil.getIterations(), 0);
+
+  for (unsigned int k = 0; k < n; k++) {
+    for (unsigned int j = 0; j < n; j++) {
+      for (unsigned int i = 0; i < n; i++) {
+        ASSERT_NEAR(expected.get(i, j, k), pressure.get(i, j, k), 1e-3);
+      }
+    }
+  }
+}
+
+TEST_F(StencilPCGSolverTest, multigridMatchesAssembledSolver) {
+  OrdinalGrid<double> expected(n, n, n);
+  OrdinalGrid<double> pressure(n, n, n);
+  MICSolver assembled(n*n*n);
+  MultigridPreconditioner *multigrid = new MultigridPreconditioner();
+  StencilPCGSolver stencil(multigrid);
+
+  ASSERT_TRUE(assembled.solve(divergence, state, &expected, 0.1f));
+  ASSERT_TRUE(stencil.solve(divergence, state, &pressure, 0.1f));
+  EXPECT_EQ(3u, multigrid->getLevelCount());
+
+  for (unsigned int k = 0; k < n; k++) {
+    for (unsigned int j = 0; j < n; j++) {
+      for (unsigned int i = 0; i < n; i++) {
+        ASSERT_NEAR(expected.get(i, j, k), pressure.get(i, j, k), 1e-3);
+      }
+    }
+  }
+}
+
+TEST_F(StencilPCGSolverTest, levelScheduledMICMatchesSequential) {
+  PressureStencil stencil;
+  stencil.build(state, 0.1f);
+  MICPreconditioner sequential;
+  MICPreconditioner levelScheduled(true);
+  sequential.build(state, &stencil);
+  levelScheduled.build(state, &stencil);
+
+  std::vector<double> r(stencil.size());
+  for (unsigned int i = 0; i < r.size(); i++) {
+    r[i] = double(i % 7) - 3.0;
+  }
+  std::vector<double> expected(r.size());
+  std::vector<double> z(r.size());
+  sequential.apply(r, expected);
+  levelScheduled.apply(r, z);
+
+  for (unsigned int i = 0; i < r.size(); i++) {
+    ASSERT_DOUBLE_EQ(expected[i], z[i]);
+  }
+}
+
+TEST_F(StencilPCGSolverTest, operatorMatchesAssembledMatrix) {
+  SparseMatrix<double> matrix(n*n*n, 7);
+  MICSolver assembled(n*n*n);
+  assembled.fillA(&matrix, state, 0.1f);
+
+  PressureStencil stencil;
+  stencil.build(state, 0.1f);
+
+  // both number only the fluid cells, in the same order
+  const unsigned int size = stencil.size();
+  ASSERT_EQ(assembled.getFluidCells().size(), size);
+  ASSERT_EQ(matrix.n, size);
+  ASSERT_LT(size, n*n*n);
+
+  std::vector<double> x(size);
+  for (unsigned int i = 0; i < x.size(); i++) {
+    x[i] = double(i % 13) - 6.0;
+  }
+  std::vector<double> expected(size);
+  std::vector<double> result(size);
+  multiply(matrix, x, expected);
+  stencil.apply(x, result);
+
+  for (unsigned int i = 0; i < x.size(); i++) {
+    ASSERT_NEAR(expected[i], result[i], 1e-9);
+  }
+}
+
+TEST_F(StencilPCGSolverTest, fluidCellsAreNumberedInFlatOrder) {
+  FluidCellIndex fluidCells;
+  fluidCells.build(state);
+
+  int expected = 0;
+  for (unsigned int k = 0; k < n; k++) {
+    for (unsigned int j = 0; j < n; j++) {
+      for (unsigned int i = 0; i < n; i++) {
+        if (state->getCellTypeGrid()->get(i, j, k) == CellType::FLUID) {
+          ASSERT_EQ(expected, fluidCells.get(i, j, k));
+          ASSERT_EQ(GridCoordinate(i, j, k), fluidCells.getCell(expected));
+          expected++;
+        } else {
+          ASSERT_EQ(FluidCellIndex::NOT_FLUID, fluidCells.get(i, j, k));
+        }
+      }
+    }
+  }
+  ASSERT_EQ(expected, int(fluidCells.size()));
+  ASSERT_EQ(FluidCellIndex::NOT_FLUID, fluidCells.get(-1, 0, 0));
+}
+
+TEST_F(StencilPCGSolverTest, warmStartReusesPreviousPressure) {
+  OrdinalGrid<double> expected(n, n, n);
+  OrdinalGrid<double> pressure(n, n, n);
+  StencilPCGSolver cold;
+  StencilPCGSolver warm;
+  warm.setWarmStart(true);
+
+  ASSERT_TRUE(warm.solve(divergence, state, &pressure, 0.1f));
+  ASSERT_TRUE(warm.solve(divergence, state, &pressure, 0.1f));
+  EXPECT_EQ(0, warm.getIterations());
+
+  // raise the water level by one layer, the new cells start from their neighbours
+  Grid<CellType> cellTypes(*state->getCellTypeGrid());
+  for (unsigned int k = 0; k < n; k++) {
+    for (unsigned int i = 0; i < n; i++) {
+      if (cellTypes.get(i, 7, k) == CellType::EMPTY) {
+        cellTypes.set(i, 7, k, CellType::FLUID);
+      }
+    }
+  }
+  state->setCellTypeGrid(&cellTypes);
+
+  ASSERT_TRUE(cold.solve(divergence, state, &expected, 0.1f));
+  ASSERT_TRUE(warm.solve(divergence, state, &pressure, 0.1f));
+  EXPECT_LT(warm.getIterations(), cold.getIterations());
+
+  for (unsigned int k = 0; k < n; k++) {
+    for (unsigned int j = 0; j < n; j++) {
+      for (unsigned int i = 0; i < n; i++) {
+        ASSERT_NEAR(expected.get(i, j, k), pressure.get(i, j, k), 1e-3);
+      }
+    }
+  }
+}
+
+TEST_F(StencilPCGSolverTest, solidFacesFollowTheCellTypes) {
+  SolidFaces const *solidFaces = state->getSolidFaces();
+
+  // the pillar stands on the floor and reaches the top
+  ASSERT_EQ(SolidFaces::SOLID_CELL | SolidFaces::UP | SolidFaces::DOWN, solidFaces->get(5, 3, 6));
+  ASSERT_EQ(SolidFaces::RIGHT, solidFaces->get(4, 3, 6));
+  ASSERT_EQ(SolidFaces::FRONT, solidFaces->get(5, 3, 7));
+  ASSERT_EQ(SolidFaces::UP, solidFaces->get(3, 1, 3));
+  // the domain boundary is open
+  ASSERT_EQ(0, solidFaces->get(0, 3, 0));
+  ASSERT_EQ(4, SolidFaces::openFaces(solidFaces->get(4, 1, 6)));
+
+  // a copied state keeps them, new solids replace them
+  State copy(*state);
+  ASSERT_EQ(SolidFaces::RIGHT, copy.getSolidFaces()->get(4, 3, 6));
+  Grid<CellType> open(n, n, n);
+  open.setForEach([](unsigned int i, unsigned int j, unsigned int k) {
+      return CellType::FLUID;
+    });
+  copy.setCellTypeGrid(&open);
+  ASSERT_EQ(0, copy.getSolidFaces()->get(4, 3, 6));
+}
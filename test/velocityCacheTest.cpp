@@ -0,0 +1,81 @@
+#include <gtest/gtest.h>
+#include <velocityCache.h>
+#include <velocityGrid.h>
+#include <util.h>
+#include <glm/glm.hpp>
+
+class VelocityCacheTest : public ::testing::Test{
+protected:
+  VelocityCacheTest() {
+    velocities = new VelocityGrid(12, 12, 12);
+    cache = new VelocityCache(12, 12, 12);
+
+    // linear in the cell coordinates, faces of u, v and w lie half a cell before their cell
+    velocities->u->setForEach([](unsigned int i, unsigned int j, unsigned int k) {
+        return 0.1f*j + 0.2f*(i - 0.5f);
+      });
+    velocities->v->setForEach([](unsigned int i, unsigned int j, unsigned int k) {
+        return 0.05f*i - 0.1f*(j - 0.5f) + 0.3f*k;
+      });
+    velocities->w->setForEach([](unsigned int i, unsigned int j, unsigned int k) {
+        return 0.02f*(k - 0.5f) + 0.1f*j;
+      });
+    cache->update(velocities);
+  }
+
+  ~VelocityCacheTest() {
+    delete velocities;
+    delete cache;
+  }
+  VelocityGrid *velocities;
+  VelocityCache *cache;
+};
+
+TEST_F(VelocityCacheTest, sampleMatchesTheFacesOfLinearFields) {
+  glm::vec3 positions[] = {glm::vec3(5.0f, 6.0f, 7.0f), glm::vec3(5.3f, 6.7f, 7.1f), glm::vec3(3.5f, 8.25f, 4.75f)};
+  glm::vec3 batched[3];
+  cache->sampleVelocity(positions, batched, 3);
+  for (int n = 0; n < 3; n++) {
+    glm::vec3 expected = velocities->getLerp(positions[n]);
+    glm::vec3 sampled = cache->sampleVelocity(positions[n]);
+    for (int c = 0; c < 3; c++) {
+      EXPECT_NEAR(expected[c], sampled[c], 1e-5);
+      EXPECT_EQ(sampled[c], batched[n][c]);
+    }
+  }
+}
+
+TEST_F(VelocityCacheTest, backTracksMatchTheFacesOfLinearFields) {
+  glm::vec3 rows[2][8];
+  for (int k = 4; k < 8; k++) {
+    for (int j = 4; j < 8; j++) {
+      for (int i = 4; i < 8; i++) {
+        glm::vec3 faces[] = {
+          util::advect::mac::backTrackU(velocities, i, j, k, 1.0f),
+          util::advect::mac::backTrackV(velocities, i, j, k, 1.0f),
+          util::advect::mac::backTrackW(velocities, i, j, k, 1.0f),
+          util::advect::backTrack(velocities, i, j, k, 1.0f)
+        };
+        glm::vec3 cached[] = {
+          util::advect::mac::backTrackU(cache, i, j, k, 1.0f),
+          util::advect::mac::backTrackV(cache, i, j, k, 1.0f),
+          util::advect::mac::backTrackW(cache, i, j, k, 1.0f),
+          util::advect::backTrack(cache, i, j, k, 1.0f)
+        };
+        for (int n = 0; n < 4; n++) {
+          for (int c = 0; c < 3; c++) {
+            EXPECT_NEAR(faces[n][c], cached[n][c], 1e-5);
+          }
+        }
+      }
+    }
+  }
+
+  util::advect::mac::backTrackRowU(cache, 4, 5, 6, 4, 1.0f, rows[0]);
+  for (int i = 0; i < 4; i++) {
+    rows[1][i] = util::advect::mac::backTrackU(cache, 4 + i, 5, 6, 1.0f);
+    for (int c = 0; c < 3; c++) {
+      EXPECT_NEAR(rows[0][i][c], rows[1][i][c], 1e-6);
+    }
+  }
+}
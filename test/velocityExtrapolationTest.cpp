@@ -0,0 +1,84 @@
+#include <gtest/gtest.h>
+#include <simulator.h>
+#include <state.h>
+#include <levelSet.h>
+#include <velocityGrid.h>
+#include <ordinalGrid.h>
+#include <glm/glm.hpp>
+
+class VelocityExtrapolationTest : public ::testing::Test{
+protected:
+  VelocityExtrapolationTest() {
+    // a single fluid cell at (8, 8, 8) in an empty box
+    State state(n, n, n);
+    LevelSet levelSet(n, n, n,
+      [](const unsigned int &i, const unsigned int &j, const unsigned int &k) {
+        return glm::distance(glm::vec3(i, j, k), glm::vec3(8.0f)) - 0.5f;
+      }, [](unsigned int i, unsigned int j, unsigned int k) {
+        return CellType::EMPTY;
+      });
+    state.setLevelSet(&levelSet);
+
+    // the two u faces of the fluid cell are the only ones with a velocity, the
+    // others hold a marker that extrapolation overwrites
+    VelocityGrid velocities(n, n, n);
+    velocities.u->setForEach([](unsigned int i, unsigned int j, unsigned int k) {
+        return UNTOUCHED;
+      });
+    velocities.u->set(8, 8, 8, 1.0f);
+    velocities.u->set(9, 8, 8, 3.0f);
+    state.setVelocityGrid(&velocities);
+
+    sim = new Simulator(state);
+  }
+
+  ~VelocityExtrapolationTest() {
+    delete sim;
+  }
+
+  float u(unsigned int i, unsigned int j, unsigned int k) {
+    return sim->getCurrentState()->getVelocityGrid()->u->get(i, j, k);
+  }
+
+  static constexpr unsigned int n = 16;
+  static constexpr float UNTOUCHED = 0.5f;
+  Simulator *sim;
+};
+
+constexpr unsigned int VelocityExtrapolationTest::n;
+constexpr float VelocityExtrapolationTest::UNTOUCHED;
+
+TEST_F(VelocityExtrapolationTest, layersAverageTheEarlierLayers) {
+  sim->setExtrapolationDepth(2);
+  sim->extrapolateVelocity(sim->getCurrentState(), 0.0f);
+
+  // layer 1 only touches one face of the fluid cell
+  EXPECT_EQ(1.0f, u(7, 8, 8));
+  EXPECT_EQ(3.0f, u(10, 8, 8));
+  EXPECT_EQ(1.0f, u(8, 9, 8));
+  EXPECT_EQ(3.0f, u(9, 8, 7));
+  // layer 2 averages its layer 1 neighbours
+  EXPECT_EQ(1.0f, u(6, 8, 8));
+  EXPECT_EQ(3.0f, u(11, 8, 8));
+  EXPECT_EQ(1.0f, u(7, 9, 8));
+  EXPECT_EQ(3.0f, u(9, 9, 9));
+  // layer 3 is beyond the depth
+  EXPECT_EQ(UNTOUCHED, u(5, 8, 8));
+  EXPECT_EQ(UNTOUCHED, u(12, 8, 8));
+  EXPECT_EQ(UNTOUCHED, u(7, 9, 9));
+}
+
+TEST_F(VelocityExtrapolationTest, depthCoversTheTravelDistance) {
+  sim->setExtrapolationDepth(1);
+  // the fastest face moves 3*0.1 faces, so one layer plus one for the interpolation
+  sim->extrapolateVelocity(sim->getCurrentState(), 0.1f);
+  EXPECT_EQ(1.0f, u(6, 8, 8));
+  EXPECT_EQ(3.0f, u(11, 8, 8));
+  EXPECT_EQ(UNTOUCHED, u(5, 8, 8));
+
+  // 3 faces take four layers
+  sim->extrapolateVelocity(sim->getCurrentState(), 1.0f);
+  EXPECT_EQ(1.0f, u(4, 8, 8));
+  EXPECT_EQ(3.0f, u(13, 8, 8));
+  EXPECT_EQ(UNTOUCHED, u(3, 8, 8));
+}